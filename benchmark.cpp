@@ -7,6 +7,49 @@
 #include <atomic>
 #include <algorithm>
 #include <numeric>
+#include <iomanip>
+#include <unordered_map>
+#include <cmath>
+#include <charconv>
+#include <string_view>
+#include <fstream>
+#include <malloc.h>
+#include <unistd.h>
+
+// Bytes the whole process has in use on the malloc heap, chunk headers
+// included, so allocations and frees made by the store's clock and reclaimer
+// threads are counted as well. Read from malloc itself rather than by
+// replacing operator new, which would add a header to every allocation in
+// the benchmark and skew both the throughput and the RSS figures.
+static int64_t heap_in_use() {
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<int64_t>(info.uordblks + info.hblkhd);
+}
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s.
+class ZipfGenerator {
+private:
+    std::vector<double> cdf_;
+    std::uniform_real_distribution<> uniform_{0.0, 1.0};
+    
+public:
+    ZipfGenerator(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+            cdf_[i] = sum;
+        }
+        for (double& c : cdf_) {
+            c /= sum;
+        }
+    }
+    
+    template <typename Rng>
+    size_t operator()(Rng& rng) {
+        auto it = std::lower_bound(cdf_.begin(), cdf_.end(), uniform_(rng));
+        return std::min<size_t>(it - cdf_.begin(), cdf_.size() - 1);
+    }
+};
 
 class Benchmark {
 private:
@@ -22,7 +65,7 @@ private:
         
         std::string result;
         result.reserve(length);
-        for (size_t i = 0; i &lt; length; ++i) {
+        for (size_t i = 0; i < length; ++i) {
             result += charset[dis(gen)];
         }
         return result;
@@ -34,10 +77,14 @@ private:
         std::uniform_real_distribution<> op_dis(0.0, 1.0);
         std::uniform_int_distribution<> key_dis(1, 10000);
         
-        for (int i = 0; i &lt; num_operations && !stop_flag_; ++i) {
-            std::string key = "key_" + std::to_string(key_dis(gen));
+        // Format keys in place so the read path does not allocate
+        char key_buf[32] = "key_";
+        
+        for (int i = 0; i < num_operations && !stop_flag_; ++i) {
+            auto res = std::to_chars(key_buf + 4, key_buf + sizeof(key_buf), key_dis(gen));
+            std::string_view key(key_buf, res.ptr - key_buf);
             
-            if (op_dis(gen) &lt; read_ratio) {
+            if (op_dis(gen) < read_ratio) {
                 // Read operation
                 std::string value;
                 store_.get(key, value);
@@ -55,10 +102,13 @@ public:
     explicit Benchmark(kvstore::KVStore& store) : store_(store) {}
     
     void run_concurrent_benchmark(int num_threads, int operations_per_thread, double read_ratio) {
-        std::cout &lt;&lt; "Running concurrent benchmark:\n"
-                  &lt;&lt; "  Threads: " &lt;&lt; num_threads &lt;&lt; "\n"
-                  &lt;&lt; "  Operations per thread: " &lt;&lt; operations_per_thread &lt;&lt; "\n"
-                  &lt;&lt; "  Read ratio: " &lt;&lt; (read_ratio * 100) &lt;&lt; "%\n\n";
+        std::cout << "Running concurrent benchmark:\n"
+                  << "  Threads: " << num_threads << "\n"
+                  << "  Shards: " << store_.shard_count() << "\n"
+                  << "  Recency: " << (store_.recency_mode() == kvstore::RecencyMode::Clock ? "clock" : "strict") << "\n"
+                  << "  Policy: " << kvstore::eviction_policy_name(store_.policy_type()) << "\n"
+                  << "  Operations per thread: " << operations_per_thread << "\n"
+                  << "  Read ratio: " << (read_ratio * 100) << "%\n\n";
         
         // Reset metrics
         store_.clear();
@@ -69,7 +119,7 @@ public:
         
         // Launch worker threads
         std::vector<std::thread> threads;
-        for (int i = 0; i &lt; num_threads; ++i) {
+        for (int i = 0; i < num_threads; ++i) {
             threads.emplace_back(&Benchmark::worker_thread, this, i, operations_per_thread, read_ratio);
         }
         
@@ -87,29 +137,87 @@ public:
         
         const auto& metrics = store_.get_metrics();
         
-        std::cout &lt;&lt; "Benchmark Results:\n"
-                  &lt;&lt; "  Total operations: " &lt;&lt; total_ops &lt;&lt; "\n"
-                  &lt;&lt; "  Duration: " &lt;&lt; duration.count() &lt;&lt; " ms\n"
-                  &lt;&lt; "  Operations/sec: " &lt;&lt; std::fixed &lt;&lt; std::setprecision(2) &lt;&lt; ops_per_second &lt;&lt; "\n"
-                  &lt;&lt; "  Cache hit rate: " &lt;&lt; std::fixed &lt;&lt; std::setprecision(2) 
-                  &lt;&lt; (metrics.hit_rate() * 100) &lt;&lt; "%\n"
-                  &lt;&lt; "  Final cache size: " &lt;&lt; store_.size() &lt;&lt; "\n"
-                  &lt;&lt; "  Evictions: " &lt;&lt; metrics.evictions &lt;&lt; "\n\n";
+        std::cout << "Benchmark Results:\n"
+                  << "  Total operations: " << total_ops << "\n"
+                  << "  Duration: " << duration.count() << " ms\n"
+                  << "  Operations/sec: " << std::fixed << std::setprecision(2) << ops_per_second << "\n"
+                  << "  Cache hit rate: " << std::fixed << std::setprecision(2) 
+                  << (metrics.hit_rate() * 100) << "%\n"
+                  << "  Final cache size: " << store_.size() << "\n"
+                  << "  Memory used: " << metrics.memory_used_bytes << " bytes\n"
+                  << "  Evictions: " << metrics.evictions << "\n";
+        for (size_t op = 0; op < kvstore::kOpTypes; ++op) {
+            auto latency = metrics.latency[op].snapshot();
+            if (latency.total == 0) {
+                continue;
+            }
+            std::cout << "  " << kvstore::op_type_name(static_cast<kvstore::OpType>(op))
+                      << " latency (us): p50 " << latency.percentile(50) / 1000.0
+                      << ", p99 " << latency.percentile(99) / 1000.0
+                      << ", p99.9 " << latency.percentile(99.9) / 1000.0
+                      << " (" << latency.total << " samples)\n";
+        }
+        for (size_t shard = 0; shard < metrics.shard_locks.size(); ++shard) {
+            const auto& lock = metrics.shard_locks[shard];
+            std::cout << "  Shard " << shard << " lock: exclusive " << lock.exclusive.contended << "/"
+                      << lock.exclusive.acquisitions << " contended, wait " << lock.exclusive.wait_ns / 1e6
+                      << " ms, hold " << lock.exclusive.hold_ns / 1e6 << " ms; shared "
+                      << lock.shared.contended << "/" << lock.shared.acquisitions << " contended, wait "
+                      << lock.shared.wait_ns / 1e6 << " ms, hold " << lock.shared.hold_ns / 1e6 << " ms\n";
+        }
+        std::cout << "\n";
+    }
+    
+    // Two counter bumps per operation, as KVStore::get makes, on one shared
+    // atomic pair versus a StripedCounter pair
+    void run_counter_benchmark(int max_threads, int operations_per_thread) {
+        std::cout << "Running metrics counter benchmark (" << operations_per_thread << " ops/thread)...\n";
+        
+        auto run = [&](int threads, auto& total, auto& hits) {
+            auto start = std::chrono::high_resolution_clock::now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&] {
+                    for (int i = 0; i < operations_per_thread; ++i) {
+                        total++;
+                        hits++;
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            return static_cast<double>(threads) * operations_per_thread / elapsed.count() / 1e6;
+        };
+        
+        std::cout << "Counter Results (million ops/sec):\n";
+        for (int threads = 1; threads <= std::max(max_threads, 8); threads *= 2) {
+            std::atomic<uint64_t> shared_total{0};
+            std::atomic<uint64_t> shared_hits{0};
+            kvstore::StripedCounter striped_total;
+            kvstore::StripedCounter striped_hits;
+            double shared_rate = run(threads, shared_total, shared_hits);
+            double striped_rate = run(threads, striped_total, striped_hits);
+            std::cout << "  " << threads << " threads: shared atomic " << std::fixed << std::setprecision(1)
+                      << shared_rate << ", striped " << striped_rate << "\n";
+        }
+        std::cout << "\n";
     }
     
-    void run_latency_test(int num_operations) {
-        std::cout &lt;&lt; "Running latency test with " &lt;&lt; num_operations &lt;&lt; " operations...\n";
+    void run_latency_test(int num_operations, size_t growth_keys) {
+        std::cout << "Running latency test with " << num_operations << " operations...\n";
         
         std::vector<double> latencies;
         latencies.reserve(num_operations);
         
         // Warm up
-        for (int i = 0; i &lt; 1000; ++i) {
+        for (int i = 0; i < 1000; ++i) {
             store_.put("warmup_" + std::to_string(i), "value");
         }
         
         // Measure latencies
-        for (int i = 0; i &lt; num_operations; ++i) {
+        for (int i = 0; i < num_operations; ++i) {
             std::string key = "latency_test_" + std::to_string(i);
             std::string value = generate_random_string(100);
             
@@ -128,60 +236,521 @@ public:
         double p95 = latencies[latencies.size() * 0.95];
         double p99 = latencies[latencies.size() * 0.99];
         
-        std::cout &lt;&lt; "Latency Results (microseconds):\n"
-                  &lt;&lt; "  Average: " &lt;&lt; std::fixed &lt;&lt; std::setprecision(2) &lt;&lt; avg &lt;&lt; "\n"
-                  &lt;&lt; "  P50: " &lt;&lt; p50 &lt;&lt; "\n"
-                  &lt;&lt; "  P95: " &lt;&lt; p95 &lt;&lt; "\n"
-                  &lt;&lt; "  P99: " &lt;&lt; p99 &lt;&lt; "\n"
-                  &lt;&lt; "  Min: " &lt;&lt; latencies.front() &lt;&lt; "\n"
-                  &lt;&lt; "  Max: " &lt;&lt; latencies.back() &lt;&lt; "\n\n";
+        std::cout << "Latency Results (microseconds):\n"
+                  << "  Average: " << std::fixed << std::setprecision(2) << avg << "\n"
+                  << "  P50: " << p50 << "\n"
+                  << "  P95: " << p95 << "\n"
+                  << "  P99: " << p99 << "\n"
+                  << "  Min: " << latencies.front() << "\n"
+                  << "  Max: " << latencies.back() << "\n\n";
+        
+        // Time every put while a fresh store grows from empty, so index
+        // resizes show up in the tail instead of being averaged away
+        std::cout << "Measuring put latency while growing to " << growth_keys << " keys...\n";
+        kvstore::KVStore growing(growth_keys);
+        std::vector<float> growth_latencies;
+        growth_latencies.reserve(growth_keys);
+        const std::string value(16, 'v');
+        for (size_t i = 0; i < growth_keys; ++i) {
+            std::string key = "grow_" + std::to_string(i);
+            
+            auto start = std::chrono::high_resolution_clock::now();
+            growing.put(key, value);
+            auto end = std::chrono::high_resolution_clock::now();
+            
+            growth_latencies.push_back(std::chrono::duration<float, std::micro>(end - start).count());
+        }
+        
+        size_t slow_puts = std::count_if(growth_latencies.begin(), growth_latencies.end(),
+                                         [](float us) { return us > 1000.0f; });
+        auto p999 = growth_latencies.begin() + growth_latencies.size() * 0.999;
+        std::nth_element(growth_latencies.begin(), p999, growth_latencies.end());
+        float max = *std::max_element(p999, growth_latencies.end());
+        std::cout << "Growth Latency Results (microseconds):\n"
+                  << "  P99.9: " << std::fixed << std::setprecision(2) << *p999 << "\n"
+                  << "  Max: " << max << "\n"
+                  << "  Puts over 1 ms: " << slow_puts << "\n\n";
+    }
+    
+    void run_index_benchmark(size_t num_keys) {
+        std::cout << "Running index microbenchmark with " << num_keys << " keys...\n";
+        
+        std::vector<std::string> keys;
+        std::vector<std::string> missing;
+        keys.reserve(num_keys);
+        missing.reserve(num_keys);
+        for (size_t i = 0; i < num_keys; ++i) {
+            keys.push_back("key_" + std::to_string(i));
+            missing.push_back("absent_" + std::to_string(i));
+        }
+        
+        // Probe in a shuffled order so neither structure benefits from insertion locality
+        std::vector<uint32_t> order(num_keys);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937(42));
+        
+        kvstore::FlatIndex flat;
+        std::unordered_map<std::string, uint32_t> map;
+        for (uint32_t id = 0; id < num_keys; ++id) {
+            flat.insert(kvstore::hash_key(keys[id]), id);
+            map.emplace(keys[id], id);
+        }
+        
+        auto time_ns_per_op = [&](auto&& lookup, const std::vector<std::string>& probe) {
+            uint64_t found = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i : order) {
+                found += lookup(probe[i]);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            // Keep the lookups observable so they are not optimized away
+            if (found == UINT64_MAX) {
+                std::cout << found;
+            }
+            return std::chrono::duration<double, std::nano>(end - start).count() / num_keys;
+        };
+        
+        auto flat_lookup = [&](const std::string& key) -> uint64_t {
+            uint32_t id = flat.find(kvstore::hash_key(key), [&](uint32_t candidate) { return keys[candidate] == key; });
+            return id != kvstore::FlatIndex::kNotFound;
+        };
+        auto map_lookup = [&](const std::string& key) -> uint64_t {
+            return map.find(key) != map.end();
+        };
+        
+        std::cout << "Index Results (ns/lookup):\n"
+                  << "  FlatIndex hit: " << std::fixed << std::setprecision(2) << time_ns_per_op(flat_lookup, keys) << "\n"
+                  << "  FlatIndex miss: " << time_ns_per_op(flat_lookup, missing) << "\n"
+                  << "  unordered_map hit: " << time_ns_per_op(map_lookup, keys) << "\n"
+                  << "  unordered_map miss: " << time_ns_per_op(map_lookup, missing) << "\n"
+                  << "  FlatIndex group width: " << kvstore::FlatIndex::kGroupWidth << " bytes\n\n";
+    }
+    
+    // Cache-aside hit rate of each eviction policy on a Zipfian workload, with
+    // and without periodic one-off scans mixed in. Only Zipfian requests after
+    // a warm-up fifth count toward the hit rate, so it shows how well the hot
+    // set survives the scans.
+    void run_policy_comparison(size_t capacity, size_t num_keys, size_t num_operations) {
+        std::cout << "Running eviction policy comparison (capacity " << capacity
+                  << ", " << num_keys << " Zipfian keys, s=0.99)...\n";
+        
+        ZipfGenerator zipf(num_keys, 0.99);
+        std::cout << "Policy Hit Rates (zipf / zipf+scans):\n";
+        
+        for (auto policy : {kvstore::EvictionPolicyType::LRU, kvstore::EvictionPolicyType::SLRU,
+                            kvstore::EvictionPolicyType::ARC, kvstore::EvictionPolicyType::WTinyLFU}) {
+            double rates[2];
+            for (int with_scans = 0; with_scans < 2; ++with_scans) {
+                kvstore::KVStoreOptions options;
+                options.capacity = capacity;
+                options.policy = policy;
+                kvstore::KVStore policy_store(options);
+                
+                std::mt19937 gen(7);
+                std::string value;
+                uint64_t hits = 0;
+                uint64_t measured = 0;
+                uint64_t scan_key = 0;
+                for (size_t i = 0; i < num_operations; ++i) {
+                    if (with_scans && i > 0 && i % 10000 == 0) {
+                        // A scan touches 2x capacity keys that are never seen again
+                        for (size_t j = 0; j < capacity * 2; ++j) {
+                            std::string key = "scan_" + std::to_string(scan_key++);
+                            if (!policy_store.get(key, value)) {
+                                policy_store.put(key, "v");
+                            }
+                        }
+                    }
+                    
+                    std::string key = "key_" + std::to_string(zipf(gen));
+                    bool hit = policy_store.get(key, value);
+                    if (!hit) {
+                        policy_store.put(key, "v");
+                    }
+                    if (i >= num_operations / 5) {
+                        hits += hit;
+                        measured++;
+                    }
+                }
+                rates[with_scans] = 100.0 * hits / measured;
+            }
+            std::cout << "  " << kvstore::eviction_policy_name(policy) << ": "
+                      << std::fixed << std::setprecision(2) << rates[0] << "% / " << rates[1] << "%\n";
+        }
+        std::cout << "\n";
+    }
+    
+    // Throughput and hit rate of LRU and SIEVE under a cache-aside Zipfian
+    // workload as the thread count grows. LRU takes the exclusive lock on
+    // every hit to reorder its list; SIEVE hits only set a bit under the
+    // shared lock.
+    void run_sieve_comparison(size_t capacity, size_t num_keys, int operations_per_thread) {
+        std::cout << "Running SIEVE vs LRU comparison (capacity " << capacity
+                  << ", " << num_keys << " Zipfian keys, s=0.99, "
+                  << operations_per_thread << " ops/thread)...\n";
+        
+        std::vector<std::string> keys;
+        keys.reserve(num_keys);
+        for (size_t i = 0; i < num_keys; ++i) {
+            keys.push_back("key_" + std::to_string(i));
+        }
+        const ZipfGenerator zipf(num_keys, 0.99);
+        
+        std::cout << "SIEVE vs LRU (ops/sec, hit rate):\n";
+        for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+            std::cout << "  " << std::setw(2) << num_threads << " threads:";
+            for (auto policy : {kvstore::EvictionPolicyType::LRU, kvstore::EvictionPolicyType::SIEVE}) {
+                kvstore::KVStoreOptions options;
+                options.capacity = capacity;
+                options.policy = policy;
+                kvstore::KVStore policy_store(options);
+                
+                auto run = [&](int thread_id, int num_operations) {
+                    ZipfGenerator thread_zipf = zipf;
+                    std::mt19937 gen(thread_id);
+                    std::string value;
+                    for (int i = 0; i < num_operations; ++i) {
+                        const std::string& key = keys[thread_zipf(gen)];
+                        if (!policy_store.get(key, value)) {
+                            policy_store.put(key, "v");
+                        }
+                    }
+                };
+                
+                // Warm the cache so the timed phase measures steady state
+                run(-1, static_cast<int>(capacity * 10));
+                policy_store.reset_metrics();
+                
+                auto start = std::chrono::high_resolution_clock::now();
+                std::vector<std::thread> threads;
+                for (int t = 0; t < num_threads; ++t) {
+                    threads.emplace_back(run, t, operations_per_thread);
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                
+                double seconds = std::chrono::duration<double>(end - start).count();
+                double ops_per_second = static_cast<double>(num_threads) * operations_per_thread / seconds;
+                std::cout << "  " << kvstore::eviction_policy_name(policy) << " "
+                          << std::fixed << std::setprecision(0) << ops_per_second << " ops/s, "
+                          << std::setprecision(2) << (policy_store.get_metrics().hit_rate() * 100) << "%";
+            }
+            std::cout << "\n";
+        }
+        std::cout << "\n";
+    }
+    
+    // Per-key cost of multi_get/multi_put against a loop of single calls, by
+    // batch size. Batches take each shard's lock once and prefetch index
+    // groups before probing.
+    void run_batch_sweep(size_t num_keys, size_t num_shards, size_t keys_per_size) {
+        std::cout << "Running batch size sweep (" << num_keys << " keys, "
+                  << num_shards << " shards)...\n";
+        
+        kvstore::KVStoreOptions options;
+        options.capacity = num_keys;
+        options.num_shards = num_shards;
+        kvstore::KVStore batch_store(options);
+        
+        std::vector<std::string> keys;
+        keys.reserve(num_keys);
+        for (size_t i = 0; i < num_keys; ++i) {
+            keys.push_back("key_" + std::to_string(i));
+            batch_store.put(keys.back(), "value");
+        }
+        
+        std::mt19937 gen(11);
+        std::uniform_int_distribution<size_t> key_dis(0, num_keys - 1);
+        std::string value(50, 'v');
+        
+        std::cout << "Batch Results (ns/key: loop get, multi_get, loop put, multi_put):\n";
+        for (size_t batch_size : {1, 10, 50, 100, 200}) {
+            size_t num_batches = keys_per_size / batch_size;
+            std::vector<std::vector<std::string_view>> batches(num_batches);
+            for (auto& batch : batches) {
+                for (size_t i = 0; i < batch_size; ++i) {
+                    batch.push_back(keys[key_dis(gen)]);
+                }
+            }
+            
+            auto ns_per_key = [&](auto&& run_batch) {
+                auto start = std::chrono::high_resolution_clock::now();
+                for (const auto& batch : batches) {
+                    run_batch(batch);
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                return std::chrono::duration<double, std::nano>(end - start).count() / (num_batches * batch_size);
+            };
+            
+            std::string out;
+            double loop_get = ns_per_key([&](const std::vector<std::string_view>& batch) {
+                for (std::string_view key : batch) {
+                    batch_store.get(key, out);
+                }
+            });
+            double multi_get = ns_per_key([&](const std::vector<std::string_view>& batch) {
+                batch_store.multi_get(batch);
+            });
+            double loop_put = ns_per_key([&](const std::vector<std::string_view>& batch) {
+                for (std::string_view key : batch) {
+                    batch_store.put(key, value);
+                }
+            });
+            std::vector<std::pair<std::string_view, std::string_view>> entries;
+            double multi_put = ns_per_key([&](const std::vector<std::string_view>& batch) {
+                entries.clear();
+                for (std::string_view key : batch) {
+                    entries.emplace_back(key, value);
+                }
+                batch_store.multi_put(entries);
+            });
+            
+            std::cout << "  " << std::setw(3) << batch_size << " keys: " << std::fixed << std::setprecision(1)
+                      << loop_get << ", " << multi_get << ", " << loop_put << ", " << multi_put << "\n";
+        }
+        std::cout << "\n";
+    }
+    
+    void run_memory_test(size_t num_entries, size_t value_size) {
+        std::cout << "Running memory test with " << num_entries << " entries...\n";
+        
+        std::string value = generate_random_string(value_size);
+        size_t payload_bytes = 0;
+        
+        int64_t heap_before = heap_in_use();
+        kvstore::KVStore mem_store(num_entries);
+        for (size_t i = 0; i < num_entries; ++i) {
+            std::string key = "key_" + std::to_string(i);
+            payload_bytes += key.size() + value.size();
+            mem_store.put(key, value);
+        }
+        int64_t heap_bytes = heap_in_use() - heap_before;
+        
+        double bytes_per_entry = static_cast<double>(heap_bytes) / num_entries;
+        double payload_per_entry = static_cast<double>(payload_bytes) / num_entries;
+        
+        std::cout << "Memory Results:\n"
+                  << "  Heap bytes/entry: " << std::fixed << std::setprecision(2) << bytes_per_entry << "\n"
+                  << "  Payload bytes/entry: " << payload_per_entry << "\n"
+                  << "  Overhead bytes/entry: " << (bytes_per_entry - payload_per_entry) << "\n\n";
+    }
+    
+    // How long clear() and clear_async() hold the store, and how long the
+    // reclaimer then takes to free the detached entries.
+    void run_clear_test(size_t num_entries) {
+        std::cout << "Running clear test with " << num_entries << " entries...\n";
+        
+        kvstore::KVStore clear_store(num_entries, "", 4);
+        const std::string value(64, 'v');
+        auto fill = [&] {
+            for (size_t i = 0; i < num_entries; ++i) {
+                clear_store.put("clear_" + std::to_string(i), value);
+            }
+        };
+        auto ms_since = [](std::chrono::high_resolution_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        };
+        
+        fill();
+        auto start = std::chrono::high_resolution_clock::now();
+        clear_store.clear();
+        double sync_ms = ms_since(start);
+        
+        fill();
+        start = std::chrono::high_resolution_clock::now();
+        clear_store.clear_async();
+        double async_ms = ms_since(start);
+        uint64_t backlog = clear_store.get_metrics().reclaim_backlog;
+        while (clear_store.get_metrics().reclaim_backlog != 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        double reclaim_ms = ms_since(start);
+        
+        std::cout << "Clear Results (milliseconds):\n"
+                  << "  clear(): " << std::fixed << std::setprecision(2) << sync_ms << "\n"
+                  << "  clear_async(): " << async_ms << " (backlog " << backlog << " entries)\n"
+                  << "  Reclaimer done after: " << reclaim_ms << "\n\n";
+    }
+    
+    // Resident set size of the process, from /proc; 0 where unavailable
+    static size_t resident_bytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t total_pages = 0;
+        size_t resident_pages = 0;
+        statm >> total_pages >> resident_pages;
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    
+    // Long-running overwrite/delete churn with values of mixed sizes on
+    // both sides of the inline limit, the pattern that fragments a general
+    // purpose heap. Reports RSS and heap bytes per live entry against the
+    // live payload, plus the slab fragmentation ratio. RSS is only
+    // reported when the process grew; pages an earlier test freed and the
+    // churn reused would otherwise make it meaningless.
+    void run_churn_test(size_t num_keys, int rounds) {
+        std::cout << "Running churn test with " << num_keys << " keys for " << rounds << " rounds...\n";
+        
+        int64_t rss_before = static_cast<int64_t>(resident_bytes());
+        int64_t heap_before = heap_in_use();
+        kvstore::KVStore churn_store(num_keys);
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<size_t> key_dist(0, 2 * num_keys - 1);
+        std::uniform_int_distribution<size_t> size_dist(8, 2 * kvstore::CacheEntry::kInlineValueMax);
+        std::uniform_int_distribution<int> op_dist(0, 99);
+        const std::string filler(2 * kvstore::CacheEntry::kInlineValueMax, 'c');
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < num_keys; ++i) {
+                std::string key = "churn_" + std::to_string(key_dist(rng));
+                if (op_dist(rng) < 70) {
+                    churn_store.put(key, std::string_view(filler.data(), size_dist(rng)));
+                } else {
+                    churn_store.remove(key);
+                }
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        
+        // Walk the live entries with the cursor scan to total their payload
+        size_t entries = 0;
+        size_t payload_bytes = 0;
+        uint64_t cursor = 0;
+        do {
+            kvstore::KeyValueList batch;
+            cursor = churn_store.scan(cursor, 64, batch);
+            for (const auto& entry : batch) {
+                payload_bytes += entry.first.size() + entry.second.size();
+            }
+            entries += batch.size();
+        } while (cursor != 0);
+        
+        int64_t rss_bytes = static_cast<int64_t>(resident_bytes()) - rss_before;
+        int64_t heap_bytes = heap_in_use() - heap_before;
+        const auto& metrics = churn_store.get_metrics();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        std::cout << "Churn Results:\n"
+                  << "  Operations/sec: " << std::fixed << std::setprecision(2)
+                  << (num_keys * rounds / seconds) << "\n"
+                  << "  Live entries: " << entries << "\n"
+                  << "  Payload bytes/entry: " << static_cast<double>(payload_bytes) / entries << "\n"
+                  << "  Heap bytes/entry: " << static_cast<double>(heap_bytes) / entries << "\n";
+        if (rss_bytes > 0 && entries != 0) {
+            std::cout << "  RSS bytes/entry: " << static_cast<double>(rss_bytes) / entries << "\n"
+                      << "  RSS / payload: " << static_cast<double>(rss_bytes) / payload_bytes << "\n";
+        } else {
+            std::cout << "  RSS bytes/entry: n/a (no RSS growth measured)\n";
+        }
+        std::cout << "  Slab fragmentation: " << metrics.fragmentation_ratio() << "\n\n";
     }
 };
 
 int main(int argc, char* argv[]) {
-    size_t capacity = 10000;
+    kvstore::KVStoreOptions options;
+    options.capacity = 10000;
     int num_threads = std::thread::hardware_concurrency();
     int operations_per_thread = 10000;
     double read_ratio = 0.8;
+    size_t growth_keys = 10000000;
     
     // Parse command line arguments
-    for (int i = 1; i &lt; argc; i++) {
+    for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
-        if (arg == "--capacity" && i + 1 &lt; argc) {
-            capacity = std::stoul(argv[++i]);
-        } else if (arg == "--threads" && i + 1 &lt; argc) {
+        if (arg == "--capacity" && i + 1 < argc) {
+            options.capacity = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
             num_threads = std::stoi(argv[++i]);
-        } else if (arg == "--operations" && i + 1 &lt; argc) {
+        } else if (arg == "--operations" && i + 1 < argc) {
             operations_per_thread = std::stoi(argv[++i]);
-        } else if (arg == "--read-ratio" && i + 1 &lt; argc) {
+        } else if (arg == "--read-ratio" && i + 1 < argc) {
             read_ratio = std::stod(argv[++i]);
+        } else if (arg == "--growth-keys" && i + 1 < argc) {
+            growth_keys = std::stoul(argv[++i]);
+        } else if (arg == "--shards" && i + 1 < argc) {
+            options.num_shards = std::stoul(argv[++i]);
+        } else if (arg == "--lock-stats") {
+            options.lock_stats = true;
+        } else if (arg == "--latency-sample" && i + 1 < argc) {
+            options.latency_sample_every = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--max-memory" && i + 1 < argc) {
+            options.max_memory_bytes = std::stoull(argv[++i]);
+        } else if (arg == "--policy" && i + 1 < argc) {
+            if (!kvstore::parse_eviction_policy(argv[++i], options.policy)) {
+                std::cerr << "Unknown eviction policy: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--recency" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "clock") {
+                options.recency = kvstore::RecencyMode::Clock;
+            } else if (mode == "strict") {
+                options.recency = kvstore::RecencyMode::Strict;
+            } else {
+                std::cerr << "Unknown recency mode: " << mode << std::endl;
+                return 1;
+            }
         } else if (arg == "--help") {
-            std::cout &lt;&lt; "Usage: " &lt;&lt; argv[0] &lt;&lt; " [options]\n"
-                      &lt;&lt; "Options:\n"
-                      &lt;&lt; "  --capacity <size>     Set cache capacity (default: 10000)\n"
-                      &lt;&lt; "  --threads <count>     Set number of threads (default: hardware concurrency)\n"
-                      &lt;&lt; "  --operations <count>  Set operations per thread (default: 10000)\n"
-                      &lt;&lt; "  --read-ratio <ratio>  Set read operation ratio 0.0-1.0 (default: 0.8)\n"
-                      &lt;&lt; "  --help                Show this help\n";
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << "  --capacity <size>     Set cache capacity (default: 10000)\n"
+                      << "  --threads <count>     Set number of threads (default: hardware concurrency)\n"
+                      << "  --operations <count>  Set operations per thread (default: 10000)\n"
+                      << "  --read-ratio <ratio>  Set read operation ratio 0.0-1.0 (default: 0.8)\n"
+                      << "  --growth-keys <count> Keys inserted by the growth latency test (default: 10000000)\n"
+                      << "  --shards <count>      Set number of cache shards (default: 1)\n"
+                      << "  --recency <mode>      strict or clock (shared-lock hit path) (default: strict)\n"
+                      << "  --policy <name>       lru, slru, arc, sieve or wtinylfu (default: lru)\n"
+                      << "  --max-memory <bytes>  Evict to stay under a byte budget (default: off)\n"
+                      << "  --latency-sample <n>  Time one in n GET/PUT/DEL calls, 0 for none (default: 16)\n"
+                      << "  --lock-stats          Report per-shard lock contention and hold times\n"
+                      << "  --help                Show this help\n";
             return 0;
         }
     }
     
     try {
-        kvstore::KVStore store(capacity);
+        kvstore::KVStore store(options);
         Benchmark benchmark(store);
         
-        std::cout &lt;&lt; "KVStore Performance Benchmark\n";
-        std::cout &lt;&lt; "=============================\n\n";
+        std::cout << "KVStore Performance Benchmark\n";
+        std::cout << "=============================\n\n";
+        
+        // Measure footprint after sustained overwrite/delete churn. Runs
+        // first, before the larger tests leave freed pages in the heap for
+        // it to reuse, so its RSS growth is its own.
+        benchmark.run_churn_test(200000, 20);
         
         // Run concurrent benchmark
         benchmark.run_concurrent_benchmark(num_threads, operations_per_thread, read_ratio);
         
+        // Shared versus striped metrics counters
+        benchmark.run_counter_benchmark(num_threads, 2000000);
+        
         // Run latency test
-        benchmark.run_latency_test(10000);
+        benchmark.run_latency_test(10000, growth_keys);
+        
+        // Compare the cache index with std::unordered_map
+        benchmark.run_index_benchmark(1000000);
+        
+        // Compare eviction policies on skewed workloads
+        benchmark.run_policy_comparison(2000, 100000, 500000);
+        
+        // Scale SIEVE and LRU across threads
+        benchmark.run_sieve_comparison(10000, 100000, 20000);
+        
+        // Batched reads and writes by batch size
+        benchmark.run_batch_sweep(1000000, 4, 1000000);
+        
+        // Measure per-entry memory footprint
+        benchmark.run_memory_test(100000, 50);
+        
+        // Blocking versus background clear
+        benchmark.run_clear_test(2000000);
         
     } catch (const std::exception& e) {
-        std::cerr &lt;&lt; "Benchmark failed: " &lt;&lt; e.what() &lt;&lt; std::endl;
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
         return 1;
     }
     
@@ -4,6 +4,7 @@
 #include <vector>
 #include <iomanip>
 #include <algorithm>
+#include <stdexcept>
 
 class KVStoreCLI {
 private:
@@ -23,41 +24,103 @@ private:
         return tokens;
     }
     
+    // TTL argument in seconds. Values whose millisecond deadline would
+    // overflow are rejected rather than wrapped; a century is far beyond
+    // any useful TTL and well inside the steady clock's range.
+    std::chrono::seconds parse_ttl(const std::string& token) {
+        constexpr long long kMaxTtlSeconds = 100LL * 365 * 24 * 3600;
+        long long seconds;
+        try {
+            seconds = std::stoll(token);
+        } catch (const std::out_of_range&) {
+            seconds = kMaxTtlSeconds + 1;
+        }
+        if (seconds > kMaxTtlSeconds || seconds < -kMaxTtlSeconds) {
+            throw std::out_of_range("TTL out of range");
+        }
+        return std::chrono::seconds(seconds);
+    }
+    
     void print_help() {
-        std::cout &lt;&lt; "Available commands:\n"
-                  &lt;&lt; "  GET <key>           - Get value for key\n"
-                  &lt;&lt; "  PUT <key> <value>   - Set key to value\n"
-                  &lt;&lt; "  DEL <key>           - Delete key\n"
-                  &lt;&lt; "  CLEAR               - Clear all entries\n"
-                  &lt;&lt; "  SIZE                - Show number of entries\n"
-                  &lt;&lt; "  STATS               - Show performance statistics\n"
-                  &lt;&lt; "  SAVE                - Save snapshot to disk\n"
-                  &lt;&lt; "  LOAD                - Load snapshot from disk\n"
-                  &lt;&lt; "  HELP                - Show this help\n"
-                  &lt;&lt; "  QUIT                - Exit the program\n";
+        std::cout << "Available commands:\n"
+                  << "  GET <key>           - Get value for key\n"
+                  << "  PUT <key> <value>   - Set key to value\n"
+                  << "  DEL <key>           - Delete key\n"
+                  << "  UNLINK <key>        - Delete key, freeing a large value in the background\n"
+                  << "  INCR <key>          - Increment integer value by 1\n"
+                  << "  INCRBY <key> <n>    - Increment integer value by n\n"
+                  << "  DECR <key>          - Decrement integer value by 1\n"
+                  << "  DECRBY <key> <n>    - Decrement integer value by n\n"
+                  << "  MGET <key> [key ...] - Get values for several keys\n"
+                  << "  MSET <key> <value> [key value ...] - Set several keys\n"
+                  << "  SETEX <key> <seconds> <value> - Set key to value with a TTL\n"
+                  << "  EXPIRE <key> <seconds> - Set a key's TTL\n"
+                  << "  TTL <key>           - Show remaining TTL in seconds (-1 none, -2 missing)\n"
+                  << "  SCAN <cursor> [COUNT <n>] - Iterate keys incrementally\n"
+                  << "  OBJECT <key>        - Show a key's encoding, version, access count and idle time\n"
+                  << "  CLEAR [ASYNC]       - Clear all entries (ASYNC: free them in the background)\n"
+                  << "  SIZE                - Show number of entries\n"
+                  << "  STATS               - Show performance statistics\n"
+                  << "  SAVE                - Save snapshot to disk\n"
+                  << "  LOAD                - Load snapshot from disk\n"
+                  << "  HELP                - Show this help\n"
+                  << "  QUIT                - Exit the program\n";
     }
     
     void print_stats() {
         const auto& metrics = store_.get_metrics();
-        std::cout &lt;&lt; "Performance Statistics:\n"
-                  &lt;&lt; "  Total operations: " &lt;&lt; metrics.total_operations &lt;&lt; "\n"
-                  &lt;&lt; "  Cache hits: " &lt;&lt; metrics.cache_hits &lt;&lt; "\n"
-                  &lt;&lt; "  Cache misses: " &lt;&lt; metrics.cache_misses &lt;&lt; "\n"
-                  &lt;&lt; "  Hit rate: " &lt;&lt; std::fixed &lt;&lt; std::setprecision(2) 
-                  &lt;&lt; (metrics.hit_rate() * 100) &lt;&lt; "%\n"
-                  &lt;&lt; "  Evictions: " &lt;&lt; metrics.evictions &lt;&lt; "\n"
-                  &lt;&lt; "  Operations/sec: " &lt;&lt; std::fixed &lt;&lt; std::setprecision(2)
-                  &lt;&lt; metrics.operations_per_second() &lt;&lt; "\n"
-                  &lt;&lt; "  Current size: " &lt;&lt; store_.size() &lt;&lt; "\n";
+        std::cout << "Performance Statistics:\n"
+                  << "  Total operations: " << metrics.total_operations << "\n"
+                  << "  Cache hits: " << metrics.cache_hits << "\n"
+                  << "  Cache misses: " << metrics.cache_misses << "\n"
+                  << "  Hit rate: " << std::fixed << std::setprecision(2) 
+                  << (metrics.hit_rate() * 100) << "%\n"
+                  << "  Evictions: " << metrics.evictions << " (";
+        for (size_t r = 0; r < kvstore::kEvictionReasons; ++r) {
+            std::cout << (r != 0 ? ", " : "") << kvstore::eviction_reason_name(static_cast<kvstore::EvictionReason>(r))
+                      << " " << metrics.evictions_by_reason[r];
+        }
+        std::cout << ")\n"
+                  << "  Loads: " << metrics.loads << " (avg " << metrics.average_load_latency_us()
+                  << " us), coalesced waits: " << metrics.coalesced_waits << "\n"
+                  << "  Operations/sec: " << std::fixed << std::setprecision(2)
+                  << metrics.operations_per_second() << "\n"
+                  << "  Current size: " << store_.size() << "\n"
+                  << "  Memory used: " << metrics.memory_used_bytes << " bytes";
+        if (store_.max_memory_bytes() != 0) {
+            std::cout << " / " << store_.max_memory_bytes() << " bytes";
+        }
+        std::cout << "\n";
+        for (size_t op = 0; op < kvstore::kOpTypes; ++op) {
+            auto latency = metrics.latency[op].snapshot();
+            std::cout << "  " << kvstore::op_type_name(static_cast<kvstore::OpType>(op)) << " latency (us): p50 "
+                      << latency.percentile(50) / 1000.0 << ", p99 " << latency.percentile(99) / 1000.0
+                      << ", p99.9 " << latency.percentile(99.9) / 1000.0 << ", max "
+                      << latency.percentile(100) / 1000.0 << " (" << latency.total << " samples)\n";
+        }
+        for (size_t shard = 0; shard < metrics.shard_locks.size(); ++shard) {
+            const auto& lock = metrics.shard_locks[shard];
+            std::cout << "  Shard " << shard << " lock:";
+            for (const auto* mode : {&lock.exclusive, &lock.shared}) {
+                std::cout << (mode == &lock.exclusive ? " exclusive " : "; shared ") << mode->acquisitions
+                          << " (" << mode->contended << " contended, wait " << mode->wait_ns / 1e6
+                          << " ms, hold " << mode->hold_ns / 1e6 << " ms)";
+            }
+            std::cout << "\n";
+        }
+        std::cout << "  Reclaim backlog: " << metrics.reclaim_backlog << " entries\n";
+        std::cout << "  Slab fragmentation: " << metrics.fragmentation_ratio() << " ("
+                  << metrics.slab_reserved_bytes << " bytes reserved for "
+                  << metrics.slab_requested_bytes << ")\n";
     }
     
 public:
-    KVStoreCLI(size_t capacity, const std::string& snapshot_file = "kvstore.snap")
-        : store_(capacity, snapshot_file), running_(true) {}
+    explicit KVStoreCLI(const kvstore::KVStoreOptions& options)
+        : store_(options), running_(true) {}
     
     void run() {
-        std::cout &lt;&lt; "KVStore CLI - High Performance In-Memory Key-Value Store\n";
-        std::cout &lt;&lt; "Type 'HELP' for available commands.\n\n";
+        std::cout << "KVStore CLI - High Performance In-Memory Key-Value Store\n";
+        std::cout << "Type 'HELP' for available commands.\n\n";
         
         std::string line;
         while (running_ && std::getline(std::cin, line)) {
@@ -73,46 +136,143 @@ public:
                 if (command == "GET" && tokens.size() == 2) {
                     std::string value;
                     if (store_.get(tokens[1], value)) {
-                        std::cout &lt;&lt; "\"" &lt;&lt; value &lt;&lt; "\"\n";
+                        std::cout << "\"" << value << "\"\n";
                     } else {
-                        std::cout &lt;&lt; "(nil)\n";
+                        std::cout << "(nil)\n";
                     }
                 }
                 else if (command == "PUT" && tokens.size() >= 3) {
                     // Join all tokens after the key as the value
                     std::string value = tokens[2];
-                    for (size_t i = 3; i &lt; tokens.size(); ++i) {
+                    for (size_t i = 3; i < tokens.size(); ++i) {
                         value += " " + tokens[i];
                     }
                     store_.put(tokens[1], value);
-                    std::cout &lt;&lt; "OK\n";
+                    std::cout << "OK\n";
                 }
                 else if (command == "DEL" && tokens.size() == 2) {
                     if (store_.remove(tokens[1])) {
-                        std::cout &lt;&lt; "1\n";
+                        std::cout << "1\n";
                     } else {
-                        std::cout &lt;&lt; "0\n";
+                        std::cout << "0\n";
                     }
                 }
+                else if (command == "INCR" && tokens.size() == 2) {
+                    std::cout << store_.incr_by(tokens[1], 1) << "\n";
+                }
+                else if (command == "INCRBY" && tokens.size() == 3) {
+                    std::cout << store_.incr_by(tokens[1], std::stoll(tokens[2])) << "\n";
+                }
+                else if (command == "DECR" && tokens.size() == 2) {
+                    std::cout << store_.decr_by(tokens[1], 1) << "\n";
+                }
+                else if (command == "DECRBY" && tokens.size() == 3) {
+                    std::cout << store_.decr_by(tokens[1], std::stoll(tokens[2])) << "\n";
+                }
+                else if (command == "MGET" && tokens.size() >= 2) {
+                    std::vector<std::string_view> keys(tokens.begin() + 1, tokens.end());
+                    std::vector<kvstore::ValueRef> values = store_.multi_get(keys);
+                    for (size_t i = 0; i < values.size(); ++i) {
+                        std::cout << (i + 1) << ") ";
+                        if (values[i]) {
+                            std::cout << "\"" << values[i].view() << "\"\n";
+                        } else {
+                            std::cout << "(nil)\n";
+                        }
+                    }
+                }
+                else if (command == "MSET" && tokens.size() >= 3 && tokens.size() % 2 == 1) {
+                    std::vector<std::pair<std::string_view, std::string_view>> entries;
+                    for (size_t i = 1; i < tokens.size(); i += 2) {
+                        entries.emplace_back(tokens[i], tokens[i + 1]);
+                    }
+                    store_.multi_put(entries);
+                    std::cout << "OK\n";
+                }
+                else if (command == "SETEX" && tokens.size() >= 4) {
+                    std::string value = tokens[3];
+                    for (size_t i = 4; i < tokens.size(); ++i) {
+                        value += " " + tokens[i];
+                    }
+                    store_.put(tokens[1], value, parse_ttl(tokens[2]));
+                    std::cout << "OK\n";
+                }
+                else if (command == "EXPIRE" && tokens.size() == 3) {
+                    if (store_.expire(tokens[1], parse_ttl(tokens[2]))) {
+                        std::cout << "1\n";
+                    } else {
+                        std::cout << "0\n";
+                    }
+                }
+                else if (command == "TTL" && tokens.size() == 2) {
+                    std::chrono::milliseconds remaining;
+                    if (!store_.ttl(tokens[1], remaining)) {
+                        std::cout << "-2\n";
+                    } else if (remaining == kvstore::kNoExpiry) {
+                        std::cout << "-1\n";
+                    } else {
+                        std::cout << (remaining.count() + 500) / 1000 << "\n";
+                    }
+                }
+                else if (command == "SCAN" && (tokens.size() == 2 || tokens.size() == 4)) {
+                    size_t count = 10;
+                    if (tokens.size() == 4) {
+                        std::string option = tokens[2];
+                        std::transform(option.begin(), option.end(), option.begin(), ::toupper);
+                        if (option != "COUNT") {
+                            throw std::invalid_argument("Expected COUNT");
+                        }
+                        count = std::stoul(tokens[3]);
+                    }
+                    kvstore::KeyValueList entries;
+                    uint64_t next = store_.scan(std::stoull(tokens[1]), count, entries);
+                    std::cout << next << "\n";
+                    for (size_t i = 0; i < entries.size(); ++i) {
+                        std::cout << (i + 1) << ") \"" << entries[i].first << "\"\n";
+                    }
+                }
+                else if (command == "OBJECT" && tokens.size() == 2) {
+                    kvstore::EntryInfo info;
+                    if (!store_.inspect(tokens[1], info)) {
+                        std::cout << "(nil)\n";
+                    } else {
+                        const char* encodings[] = {"inline", "shared", "integer"};
+                        std::cout << "encoding: " << encodings[static_cast<int>(info.encoding)] << "\n"
+                                  << "size: " << info.value_size << "\n"
+                                  << "version: " << info.version << "\n"
+                                  << "accesses: " << info.access_count << "\n"
+                                  << "idle ms: " << info.idle.count() << "\n"
+                                  << "ttl ms: " << info.ttl.count() << "\n";
+                    }
+                }
+                else if (command == "UNLINK" && tokens.size() == 2) {
+                    std::cout << (store_.remove_async(tokens[1]) ? "1" : "0") << "\n";
+                }
                 else if (command == "CLEAR") {
-                    store_.clear();
-                    std::cout &lt;&lt; "OK\n";
+                    std::string mode = tokens.size() > 1 ? tokens[1] : "";
+                    std::transform(mode.begin(), mode.end(), mode.begin(), ::toupper);
+                    if (mode == "ASYNC") {
+                        store_.clear_async();
+                    } else {
+                        store_.clear();
+                    }
+                    std::cout << "OK\n";
                 }
                 else if (command == "SIZE") {
-                    std::cout &lt;&lt; store_.size() &lt;&lt; "\n";
+                    std::cout << store_.size() << "\n";
                 }
                 else if (command == "STATS") {
                     print_stats();
                 }
                 else if (command == "SAVE") {
                     store_.save_snapshot();
-                    std::cout &lt;&lt; "Snapshot saved\n";
+                    std::cout << "Snapshot saved\n";
                 }
                 else if (command == "LOAD") {
                     if (store_.load_snapshot()) {
-                        std::cout &lt;&lt; "Snapshot loaded\n";
+                        std::cout << "Snapshot loaded\n";
                     } else {
-                        std::cout &lt;&lt; "Failed to load snapshot\n";
+                        std::cout << "Failed to load snapshot\n";
                     }
                 }
                 else if (command == "HELP") {
@@ -120,50 +280,80 @@ public:
                 }
                 else if (command == "QUIT" || command == "EXIT") {
                     running_ = false;
-                    std::cout &lt;&lt; "Goodbye!\n";
+                    std::cout << "Goodbye!\n";
                 }
                 else {
-                    std::cout &lt;&lt; "Unknown command. Type 'HELP' for available commands.\n";
+                    std::cout << "Unknown command. Type 'HELP' for available commands.\n";
                 }
             }
             catch (const std::exception& e) {
-                std::cout &lt;&lt; "Error: " &lt;&lt; e.what() &lt;&lt; "\n";
+                std::cout << "Error: " << e.what() << "\n";
             }
             
             if (running_) {
-                std::cout &lt;&lt; "kvstore> ";
+                std::cout << "kvstore> ";
             }
         }
     }
 };
 
 int main(int argc, char* argv[]) {
-    size_t capacity = 1000;  // Default capacity
-    std::string snapshot_file = "kvstore.snap";
+    kvstore::KVStoreOptions options;
+    options.capacity = 1000;  // Default capacity
+    options.snapshot_file = "kvstore.snap";
     
     // Parse command line arguments
-    for (int i = 1; i &lt; argc; i++) {
+    for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
-        if (arg == "--capacity" && i + 1 &lt; argc) {
-            capacity = std::stoul(argv[++i]);
-        } else if (arg == "--snapshot" && i + 1 &lt; argc) {
-            snapshot_file = argv[++i];
+        if (arg == "--capacity" && i + 1 < argc) {
+            options.capacity = std::stoul(argv[++i]);
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            options.snapshot_file = argv[++i];
+        } else if (arg == "--shards" && i + 1 < argc) {
+            options.num_shards = std::stoul(argv[++i]);
+        } else if (arg == "--max-memory" && i + 1 < argc) {
+            options.max_memory_bytes = std::stoull(argv[++i]);
+        } else if (arg == "--policy" && i + 1 < argc) {
+            if (!kvstore::parse_eviction_policy(argv[++i], options.policy)) {
+                std::cerr << "Unknown eviction policy: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--recency" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "clock") {
+                options.recency = kvstore::RecencyMode::Clock;
+            } else if (mode == "strict") {
+                options.recency = kvstore::RecencyMode::Strict;
+            } else {
+                std::cerr << "Unknown recency mode: " << mode << std::endl;
+                return 1;
+            }
+        } else if (arg == "--latency-sample" && i + 1 < argc) {
+            options.latency_sample_every = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--lock-stats") {
+            options.lock_stats = true;
         } else if (arg == "--help") {
-            std::cout &lt;&lt; "Usage: " &lt;&lt; argv[0] &lt;&lt; " [options]\n"
-                      &lt;&lt; "Options:\n"
-                      &lt;&lt; "  --capacity <size>   Set cache capacity (default: 1000)\n"
-                      &lt;&lt; "  --snapshot <file>   Set snapshot file (default: kvstore.snap)\n"
-                      &lt;&lt; "  --help              Show this help\n";
+            std::cout << "Usage: " << argv[0] << " [options]\n"
+                      << "Options:\n"
+                      << "  --capacity <size>   Set cache capacity (default: 1000)\n"
+                      << "  --snapshot <file>   Set snapshot file (default: kvstore.snap)\n"
+                      << "  --shards <count>    Set number of cache shards (default: 1)\n"
+                      << "  --recency <mode>    strict or clock (shared-lock hit path) (default: strict)\n"
+                      << "  --policy <name>     lru, slru, arc, sieve or wtinylfu (default: lru)\n"
+                      << "  --max-memory <bytes> Evict to stay under a byte budget (default: off)\n"
+                      << "  --latency-sample <n> Time one in n GET/PUT/DEL calls, 0 for none (default: 16)\n"
+                      << "  --lock-stats        Record per-shard lock wait and hold times for STATS\n"
+                      << "  --help              Show this help\n";
             return 0;
         }
     }
     
     try {
-        KVStoreCLI cli(capacity, snapshot_file);
+        KVStoreCLI cli(options);
         cli.run();
     }
     catch (const std::exception& e) {
-        std::cerr &lt;&lt; "Fatal error: " &lt;&lt; e.what() &lt;&lt; std::endl;
+        std::cerr << "Fatal error: " << e.what() << std::endl;
         return 1;
     }
     
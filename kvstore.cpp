@@ -1,10 +1,159 @@
 #include "kvstore.h"
 #include <iostream>
+#include <functional>
+#include <stdexcept>
+#include <future>
+#include <algorithm>
+#include <cmath>
 
 namespace kvstore {
 
-KVStore::KVStore(size_t capacity, const std::string& snapshot_file)
-    : cache_(std::make_unique<LRUCache>(capacity)), snapshot_file_(snapshot_file) {
+namespace {
+
+// Times its scope into a histogram for one in every `every` calls on this
+// thread; the others skip the clock reads.
+class LatencySample {
+public:
+    LatencySample(LatencyHistogram& histogram, uint32_t every) {
+        thread_local uint32_t calls = 0;
+        if (every != 0 && ++calls >= every) {
+            calls = 0;
+            histogram_ = &histogram;
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+    ~LatencySample() {
+        if (histogram_) {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            histogram_->record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+    LatencySample(const LatencySample&) = delete;
+    LatencySample& operator=(const LatencySample&) = delete;
+    
+private:
+    LatencyHistogram* histogram_ = nullptr;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace
+
+const char* op_type_name(OpType type) {
+    switch (type) {
+        case OpType::Get: return "GET";
+        case OpType::Put: return "PUT";
+        case OpType::Del: return "DEL";
+    }
+    return "unknown";
+}
+
+LatencyHistogram::~LatencyHistogram() {
+    for (auto& stripe : stripes_) {
+        delete stripe.load(std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::Buckets* LatencyHistogram::allocate_stripe() {
+    auto& slot = stripes_[thread_stripe()];
+    Buckets* fresh = new Buckets();
+    Buckets* expected = nullptr;
+    // Another thread sharing the stripe may have installed one first
+    if (!slot.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+        delete fresh;
+        return expected;
+    }
+    return fresh;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot merged;
+    merged.counts.assign(kBuckets, 0);
+    for (const auto& stripe : stripes_) {
+        const Buckets* buckets = stripe.load(std::memory_order_acquire);
+        if (!buckets) {
+            continue;
+        }
+        for (size_t i = 0; i < kBuckets; ++i) {
+            uint64_t count = buckets->counts[i].load(std::memory_order_relaxed);
+            merged.counts[i] += count;
+            merged.total += count;
+        }
+    }
+    return merged;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+    p = std::min(std::max(p, 0.0), 100.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * total)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucket_floor(i + 1) - 1;
+        }
+    }
+    return kMaxValue;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& stripe : stripes_) {
+        Buckets* buckets = stripe.load(std::memory_order_acquire);
+        if (!buckets) {
+            continue;
+        }
+        for (auto& count : buckets->counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+KVStore::KVStore(size_t capacity, const std::string& snapshot_file, size_t num_shards)
+    : KVStore(KVStoreOptions{capacity, snapshot_file, num_shards, RecencyMode::Strict, 0}) {}
+
+KVStore::KVStore(const KVStoreOptions& options)
+    : clock_(std::make_shared<CoarseClock>()), reclaimer_(std::make_shared<Reclaimer>()),
+      snapshot_file_(options.snapshot_file), latency_sample_every_(options.latency_sample_every) {
+    
+    size_t capacity = options.capacity;
+    size_t num_shards = options.num_shards;
+    if (num_shards == 0) {
+        throw std::invalid_argument("Shard count must be greater than 0");
+    }
+    if (num_shards > kMaxShards) {
+        throw std::invalid_argument("Shard count exceeds the scan cursor's shard range");
+    }
+    if (capacity < num_shards && !(capacity == 0 && options.max_memory_bytes != 0)) {
+        throw std::invalid_argument("Cache capacity must be at least the shard count");
+    }
+    if (options.max_memory_bytes != 0 && options.max_memory_bytes < num_shards) {
+        throw std::invalid_argument("Memory budget must be at least one byte per shard");
+    }
+    
+    // Split capacity and memory evenly; the first (capacity % num_shards)
+    // shards take one extra slot
+    shards_.reserve(num_shards);
+    loads_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+        CacheOptions shard_options;
+        shard_options.capacity = capacity / num_shards + (i < capacity % num_shards ? 1 : 0);
+        shard_options.recency = options.recency;
+        shard_options.max_memory_bytes = options.max_memory_bytes / num_shards;
+        shard_options.policy = options.policy;
+        shard_options.ordered_index = options.ordered_index;
+        shard_options.clock = clock_;
+        shard_options.reclaimer = reclaimer_;
+        shard_options.on_evict = options.on_evict;
+        shard_options.lock_stats = options.lock_stats;
+        shards_.push_back(std::make_unique<LRUCache>(shard_options));
+        loads_.push_back(std::make_unique<PendingLoads>());
+    }
+    
+    if (options.lock_stats) {
+        metrics_.shard_locks = std::vector<LockStats>(num_shards);
+    }
     
     if (!snapshot_file_.empty()) {
         load_snapshot();
@@ -16,15 +165,53 @@ KVStore::~KVStore() {
         try {
             save_snapshot();
         } catch (const std::exception& e) {
-            std::cerr &lt;&lt; "Failed to save snapshot on destruction: " &lt;&lt; e.what() &lt;&lt; std::endl;
+            std::cerr << "Failed to save snapshot on destruction: " << e.what() << std::endl;
         }
     }
 }
 
-bool KVStore::get(const std::string& key, std::string& value) {
+size_t KVStore::shard_index(uint64_t hash) const {
+    if (shards_.size() == 1) {
+        return 0;
+    }
+    // Mix the hash so shard selection does not correlate with the group
+    // index each shard's FlatIndex derives from the same hash.
+    uint64_t h = hash * 0x9E3779B97F4A7C15ull;
+    return (h >> 32) % shards_.size();
+}
+
+void KVStore::plan_batch(std::vector<BatchKey>& batch, std::vector<uint32_t>& offsets) const {
+    offsets.assign(shards_.size() + 1, 0);
+    for (BatchKey& entry : batch) {
+        entry.hash = hash_key(entry.key);
+    }
+    if (shards_.size() == 1) {
+        offsets[1] = static_cast<uint32_t>(batch.size());
+        return;
+    }
+    
+    // Counting sort by shard, stable so a repeated key keeps its order
+    std::vector<uint32_t> shard_of(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        shard_of[i] = static_cast<uint32_t>(shard_index(batch[i].hash));
+        offsets[shard_of[i] + 1]++;
+    }
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        offsets[s + 1] += offsets[s];
+    }
+    std::vector<BatchKey> sorted(batch.size());
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        sorted[next[shard_of[i]]++] = batch[i];
+    }
+    batch.swap(sorted);
+}
+
+bool KVStore::get(std::string_view key, std::string& value) {
     metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Get)], latency_sample_every_);
     
-    bool found = cache_->get(key, value);
+    bool found = shard_for(key).get(key, value);
     if (found) {
         metrics_.cache_hits++;
     } else {
@@ -34,51 +221,397 @@ bool KVStore::get(const std::string& key, std::string& value) {
     return found;
 }
 
-void KVStore::put(const std::string& key, const std::string& value) {
+bool KVStore::get(std::string_view key, std::string& value, uint64_t& version) {
     metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Get)], latency_sample_every_);
     
-    size_t old_size = cache_->size();
-    cache_->put(key, value);
+    bool found = shard_for(key).get(key, value, version);
+    if (found) {
+        metrics_.cache_hits++;
+    } else {
+        metrics_.cache_misses++;
+    }
     
-    // Check if eviction occurred
-    if (cache_->size() &lt; old_size + 1) {
-        metrics_.evictions++;
+    return found;
+}
+
+bool KVStore::compare_and_set(std::string_view key, uint64_t expected_version, std::string_view value) {
+    metrics_.total_operations++;
+    return shard_for(key).compare_and_set(key, expected_version, value);
+}
+
+int64_t KVStore::incr_by(std::string_view key, int64_t delta) {
+    metrics_.total_operations++;
+    return shard_for(key).incr_by(key, delta);
+}
+
+int64_t KVStore::decr_by(std::string_view key, int64_t delta) {
+    metrics_.total_operations++;
+    return shard_for(key).decr_by(key, delta);
+}
+
+ValueRef KVStore::get_ref(std::string_view key) {
+    metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Get)], latency_sample_every_);
+    
+    ValueRef ref = shard_for(key).get_ref(key);
+    if (ref) {
+        metrics_.cache_hits++;
+    } else {
+        metrics_.cache_misses++;
     }
+    
+    return ref;
 }
 
-bool KVStore::remove(const std::string& key) {
+ValueRef KVStore::get_or_load(std::string_view key, const std::function<std::string(std::string_view)>& loader) {
     metrics_.total_operations++;
-    return cache_->remove(key);
+    
+    size_t index = shard_index(hash_key(key));
+    LRUCache& shard = *shards_[index];
+    PendingLoads& pending_loads = *loads_[index];
+    ValueRef ref = shard.get_ref(key);
+    if (ref) {
+        metrics_.cache_hits++;
+        return ref;
+    }
+    metrics_.cache_misses++;
+    
+    std::string owned_key(key);
+    std::promise<ValuePtr> promise;
+    {
+        std::unique_lock<std::mutex> lock(pending_loads.mutex);
+        auto it = pending_loads.loads.find(owned_key);
+        if (it != pending_loads.loads.end()) {
+            std::shared_future<ValuePtr> pending = it->second;
+            lock.unlock();
+            metrics_.coalesced_waits++;
+            return ValueRef(pending.get());
+        }
+        
+        // A load that finished after our miss has already been cached and
+        // unregistered; look again before starting another one. Only misses
+        // on this shard share the mutex held here.
+        ref = shard.get_ref(key);
+        if (ref) {
+            return ref;
+        }
+        pending_loads.loads.emplace(owned_key, promise.get_future().share());
+    }
+    
+    ValuePtr value;
+    try {
+        auto start = std::chrono::steady_clock::now();
+        value = std::make_shared<const std::string>(loader(key));
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        metrics_.loads++;
+        metrics_.load_time_ns += elapsed.count();
+        
+        // Cache before unregistering so a miss that finds no load in flight
+        // finds the value instead
+        shard.put(key, value);
+        promise.set_value(value);
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(pending_loads.mutex);
+        pending_loads.loads.erase(owned_key);
+        throw;
+    }
+    
+    std::lock_guard<std::mutex> lock(pending_loads.mutex);
+    pending_loads.loads.erase(owned_key);
+    return ValueRef(std::move(value));
+}
+
+std::vector<ValueRef> KVStore::multi_get(const std::vector<std::string_view>& keys) {
+    std::vector<BatchKey> batch(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        batch[i] = BatchKey{keys[i], 0, static_cast<uint32_t>(i)};
+    }
+    std::vector<uint32_t> offsets;
+    plan_batch(batch, offsets);
+    
+    std::vector<ValueRef> results(keys.size());
+    size_t hits = 0;
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        if (offsets[s] != offsets[s + 1]) {
+            hits += shards_[s]->get_batch(batch.data() + offsets[s], offsets[s + 1] - offsets[s], results.data());
+        }
+    }
+    
+    metrics_.total_operations += keys.size();
+    metrics_.cache_hits += hits;
+    metrics_.cache_misses += keys.size() - hits;
+    return results;
+}
+
+void KVStore::multi_put(const std::vector<std::pair<std::string_view, std::string_view>>& entries) {
+    std::vector<BatchKey> batch(entries.size());
+    std::vector<std::string_view> values(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        batch[i] = BatchKey{entries[i].first, 0, static_cast<uint32_t>(i)};
+        values[i] = entries[i].second;
+    }
+    std::vector<uint32_t> offsets;
+    plan_batch(batch, offsets);
+    
+    for (size_t s = 0; s < shards_.size(); ++s) {
+        if (offsets[s] != offsets[s + 1]) {
+            shards_[s]->put_batch(batch.data() + offsets[s], offsets[s + 1] - offsets[s], values.data());
+        }
+    }
+    
+    metrics_.total_operations += entries.size();
+}
+
+KeyValueList KVStore::collect_range(std::string_view start, std::string_view end, size_t limit) const {
+    // Each shard returns its first `limit` matches in order; the overall
+    // first `limit` are among them
+    KeyValueList results;
+    for (const auto& shard : shards_) {
+        shard->range(start, end, limit, results);
+    }
+    std::sort(results.begin(), results.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    if (limit != 0 && results.size() > limit) {
+        results.resize(limit);
+    }
+    return results;
+}
+
+KeyValueList KVStore::scan(std::string_view prefix, size_t limit) const {
+    // Keys with the prefix sort before the prefix with its last byte
+    // incremented (trailing 0xFF bytes dropped); none means no upper bound
+    std::string end(prefix);
+    while (!end.empty() && static_cast<unsigned char>(end.back()) == 0xFF) {
+        end.pop_back();
+    }
+    if (!end.empty()) {
+        end.back() = static_cast<char>(static_cast<unsigned char>(end.back()) + 1);
+    }
+    return collect_range(prefix, end, limit);
+}
+
+KeyValueList KVStore::range(std::string_view start, std::string_view end, size_t limit) const {
+    // As in LRUCache::range, an empty end means no upper bound
+    if (!end.empty() && end <= start) {
+        return KeyValueList();
+    }
+    return collect_range(start, end, limit);
+}
+
+uint64_t KVStore::scan(uint64_t cursor, size_t count, KeyValueList& out) const {
+    size_t shard = cursor >> kScanShardShift;
+    if (shard >= shards_.size()) {
+        throw std::invalid_argument("Invalid scan cursor");
+    }
+    
+    uint64_t shard_cursor = shards_[shard]->scan(cursor & ((uint64_t(1) << kScanShardShift) - 1), count, out);
+    if (shard_cursor == 0 && ++shard == shards_.size()) {
+        return 0;
+    }
+    return (static_cast<uint64_t>(shard) << kScanShardShift) | shard_cursor;
+}
+
+void KVStore::put(std::string_view key, std::string_view value) {
+    metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Put)], latency_sample_every_);
+    
+    shard_for(key).put(key, value);
+}
+
+void KVStore::put(std::string_view key, std::string_view value, std::chrono::milliseconds ttl) {
+    metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Put)], latency_sample_every_);
+    
+    shard_for(key).put(key, value, ttl);
+}
+
+bool KVStore::remove(std::string_view key) {
+    metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Del)], latency_sample_every_);
+    return shard_for(key).remove(key);
+}
+
+bool KVStore::expire(std::string_view key, std::chrono::milliseconds ttl) {
+    metrics_.total_operations++;
+    return shard_for(key).expire(key, ttl);
+}
+
+bool KVStore::ttl(std::string_view key, std::chrono::milliseconds& remaining) {
+    metrics_.total_operations++;
+    return shard_for(key).ttl(key, remaining);
+}
+
+bool KVStore::inspect(std::string_view key, EntryInfo& info) {
+    metrics_.total_operations++;
+    return shard_for(key).inspect(key, info);
+}
+
+size_t KVStore::purge_expired() {
+    size_t purged = 0;
+    for (auto& shard : shards_) {
+        purged += shard->purge_expired();
+    }
+    return purged;
 }
 
 void KVStore::clear() {
-    cache_->clear();
+    for (auto& shard : shards_) {
+        shard->clear();
+    }
+    reset_metrics();
+}
+
+bool KVStore::remove_async(std::string_view key) {
+    metrics_.total_operations++;
+    LatencySample sample(metrics_.latency[static_cast<size_t>(OpType::Del)], latency_sample_every_);
+    return shard_for(key).remove_async(key);
+}
+
+void KVStore::clear_async() {
+    for (auto& shard : shards_) {
+        shard->clear_async();
+    }
     reset_metrics();
 }
 
 void KVStore::save_snapshot() const {
-    if (!snapshot_file_.empty()) {
-        cache_->save_snapshot(snapshot_file_);
+    if (snapshot_file_.empty()) {
+        return;
     }
+    
+    std::ofstream file(snapshot_file_, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open snapshot file for writing");
+    }
+    
+    // Same format as LRUCache::save_snapshot, with all shards in one file
+    uint32_t version = 1;
+    uint32_t count = 0;
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    auto count_pos = file.tellp();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    
+    for (const auto& shard : shards_) {
+        count += shard->write_entries(file);
+    }
+    file.seekp(count_pos);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
 }
 
 bool KVStore::load_snapshot() {
-    if (!snapshot_file_.empty()) {
-        return cache_->load_snapshot(snapshot_file_);
+    if (snapshot_file_.empty()) {
+        return false;
+    }
+    if (shards_.size() == 1) {
+        return shards_[0]->load_snapshot(snapshot_file_);
+    }
+    
+    std::ifstream file(snapshot_file_, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    
+    uint32_t version, count;
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || version != 1) {
+        return false;
     }
-    return false;
+    
+    for (auto& shard : shards_) {
+        shard->clear();
+    }
+    
+    // Route each record to its shard; a shard that overflows evicts as usual
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t key_size, value_size;
+        file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+        std::string key(key_size, '\0');
+        file.read(&key[0], key_size);
+        
+        file.read(reinterpret_cast<char*>(&value_size), sizeof(value_size));
+        std::string value(value_size, '\0');
+        file.read(&value[0], value_size);
+        if (!file) {
+            return false;
+        }
+        
+        shard_for(key).put(key, value);
+    }
+    
+    return true;
+}
+
+const PerformanceMetrics& KVStore::get_metrics() const {
+    metrics_.memory_used_bytes = memory_usage();
+    size_t requested = 0;
+    size_t reserved = 0;
+    for (const auto& shard : shards_) {
+        size_t shard_requested, shard_reserved;
+        shard->slab_usage(shard_requested, shard_reserved);
+        requested += shard_requested;
+        reserved += shard_reserved;
+    }
+    metrics_.slab_requested_bytes = requested;
+    metrics_.slab_reserved_bytes = reserved;
+    metrics_.reclaim_backlog = reclaimer_->backlog();
+    for (size_t r = 0; r < kEvictionReasons; ++r) {
+        uint64_t count = 0;
+        for (const auto& shard : shards_) {
+            count += shard->eviction_count(static_cast<EvictionReason>(r));
+        }
+        metrics_.evictions_by_reason[r] = count;
+    }
+    for (size_t s = 0; s < metrics_.shard_locks.size(); ++s) {
+        metrics_.shard_locks[s].shared.copy_from(shards_[s]->lock_stats().shared);
+        metrics_.shard_locks[s].exclusive.copy_from(shards_[s]->lock_stats().exclusive);
+    }
+    metrics_.evictions = metrics_.evictions_by_reason[static_cast<size_t>(EvictionReason::Capacity)] +
+                         metrics_.evictions_by_reason[static_cast<size_t>(EvictionReason::Memory)];
+    return metrics_;
 }
 
 void KVStore::reset_metrics() {
-    metrics_ = PerformanceMetrics();
+    metrics_.reset();
+    for (auto& shard : shards_) {
+        shard->reset_eviction_counts();
+        shard->reset_lock_stats();
+    }
 }
 
 size_t KVStore::size() const {
-    return cache_->size();
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->size();
+    }
+    return total;
+}
+
+size_t KVStore::memory_usage() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->memory_usage();
+    }
+    return total;
+}
+
+size_t KVStore::max_memory_bytes() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->max_memory_bytes();
+    }
+    return total;
 }
 
 bool KVStore::empty() const {
-    return cache_->empty();
+    for (const auto& shard : shards_) {
+        if (!shard->empty()) {
+            return false;
+        }
+    }
+    return true;
 }
 
 } // namespace kvstore
@@ -1,72 +1,1227 @@
 #pragma once
 
 #include <unordered_map>
+#include <map>
 #include <list>
+#include <mutex>
 #include <shared_mutex>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
 #include <chrono>
 #include <atomic>
 #include <fstream>
+#include <iosfwd>
+#include <functional>
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace kvstore {
 
-struct CacheEntry {
-    std::string value;
-    std::chrono::steady_clock::time_point last_accessed;
-    size_t access_count;
-    
-    CacheEntry(const std::string& val) 
-        : value(val), last_accessed(std::chrono::steady_clock::now()), access_count(1) {}
+// How a cache hit records recency.
+enum class RecencyMode {
+    // Every hit moves the entry to the front of the list under the exclusive lock.
+    Strict,
+    // Hits only set the entry's reference bit under the shared lock, so reads run
+    // in parallel. Eviction gives referenced entries a second chance (CLOCK).
+    Clock
 };
 
-class LRUCache {
+inline uint64_t hash_key(std::string_view key) {
+    return std::hash<std::string_view>{}(key);
+}
+
+// Open-addressing index from key hash to node id, laid out like a Swiss table.
+// Each slot has a control byte holding a 7-bit hash fingerprint (or an empty /
+// deleted marker) and stores a 32-bit hash next to the node id, so a probe
+// compares a whole group of control bytes with one SIMD instruction and most
+// misses never touch the key bytes. Groups are aligned and probed
+// triangularly; keys are compared through a caller-supplied predicate.
+//
+// Resizing is incremental: a full table becomes the old table and each insert
+// or erase moves a few of its groups into the new one, so no single write
+// pays for rehashing every key. Lookups check the new table, then the old.
+class FlatIndex {
+public:
+    static constexpr uint32_t kNotFound = UINT32_MAX;
+
+#if defined(__AVX2__)
+    static constexpr size_t kGroupWidth = 32;
+#else
+    static constexpr size_t kGroupWidth = 16;
+#endif
+
+    // Old-table groups moved per insert or erase while a resize is running.
+    // The table doubles, so even one group per insert finishes long before
+    // the next resize; two also keeps erase-heavy phases moving.
+    static constexpr size_t kMigrateGroups = 2;
+    
+    FlatIndex() { clear(); }
+    
+    template <typename KeyEq>
+    uint32_t find(uint64_t hash, KeyEq&& key_eq) const {
+        uint32_t h = fold(hash);
+        uint32_t id = find_in(table_, h, key_eq);
+        if (id == kNotFound && old_.ctrl) {
+            id = find_in(old_, h, key_eq);
+        }
+        return id;
+    }
+    
+    // Cursor iteration in the style of Redis SCAN, one home group per call:
+    // calls fn(id) for every id whose hash maps to the group at cursor and
+    // returns the next cursor, 0 when done. Cursors advance in reverse-bit
+    // order, so growing the table between calls only splits unvisited
+    // groups and every id present throughout is visited at least once
+    // (possibly twice).
+    template <typename Fn>
+    uint64_t scan(uint64_t cursor, Fn&& fn) const {
+        if (!old_.ctrl) {
+            scan_home(table_, cursor & table_.group_mask, fn);
+            return next_cursor(cursor, table_.group_mask);
+        }
+        
+        // Mid-resize: visit the old table's group, then every group of the
+        // new table it splits into, as Redis does while rehashing
+        size_t small_mask = old_.group_mask;
+        size_t large_mask = table_.group_mask;
+        scan_home(old_, cursor & small_mask, fn);
+        do {
+            scan_home(table_, cursor & large_mask, fn);
+            cursor = next_cursor(cursor, large_mask);
+        } while ((cursor & (small_mask ^ large_mask)) != 0);
+        return cursor;
+    }
+    
+    // Starts loading the first group a lookup of hash will probe, so batch
+    // lookups can overlap their cache misses.
+    void prefetch(uint64_t hash) const {
+        size_t group = (fold(hash) >> 7) & table_.group_mask;
+        __builtin_prefetch(table_.ctrl.get() + group * kGroupWidth);
+        __builtin_prefetch(table_.slots.get() + group * kGroupWidth);
+    }
+    
+    // Inserts an id whose key is known to be absent.
+    void insert(uint64_t hash, uint32_t id);
+    // Removes the slot holding id; returns false if it is not indexed.
+    bool erase(uint64_t hash, uint32_t id);
+    void clear();
+    
+    size_t size() const { return table_.size + old_.size; }
+    size_t capacity() const { return table_.capacity(); }
+    size_t memory_bytes() const {
+        return (table_.capacity() + old_.capacity()) * (sizeof(int8_t) + sizeof(Slot));
+    }
+    bool resizing() const { return old_.ctrl != nullptr; }
+    
 private:
-    struct Node {
-        std::string key;
-        std::shared_ptr<CacheEntry> entry;
-        std::shared_ptr<Node> prev, next;
+    struct Slot {
+        uint32_t hash;
+        uint32_t id;
+    };
+    
+    // Control bytes come from calloc: a fresh zeroed allocation costs nothing
+    // up front, and zero is the empty marker
+    struct FreeDeleter {
+        void operator()(int8_t* p) const { std::free(p); }
+    };
+    
+    struct Table {
+        std::unique_ptr<int8_t[], FreeDeleter> ctrl;
+        std::unique_ptr<Slot[]> slots;
+        size_t group_mask = 0;
+        size_t size = 0;
+        size_t tombstones = 0;
         
-        Node(const std::string& k, std::shared_ptr<CacheEntry> e) 
-            : key(k), entry(e) {}
+        size_t capacity() const { return ctrl ? (group_mask + 1) * kGroupWidth : 0; }
+    };
+    
+    static constexpr int8_t kEmpty = 0;
+    static constexpr int8_t kDeleted = 1;
+    static constexpr uint32_t kGroupBits = static_cast<uint32_t>((uint64_t(1) << kGroupWidth) - 1);
+    
+    Table table_;
+    // Table being drained by a resize; null ctrl when none is running
+    Table old_;
+    size_t migrated_ = 0;
+    
+    static uint32_t fold(uint64_t hash) { return static_cast<uint32_t>(hash ^ (hash >> 32)); }
+    static int8_t fingerprint(uint32_t h) { return static_cast<int8_t>(0x80 | (h & 0x7F)); }
+    
+    static uint64_t reverse_bits(uint64_t v) {
+        v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+        v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+        v = ((v >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((v & 0x0F0F0F0F0F0F0F0Full) << 4);
+        return __builtin_bswap64(v);
+    }
+    
+    // Increments the group bits of a scan cursor from the top down.
+    static uint64_t next_cursor(uint64_t cursor, size_t group_mask) {
+        cursor |= ~static_cast<uint64_t>(group_mask);
+        return reverse_bits(reverse_bits(cursor) + 1);
+    }
+    
+    // Bit i of the result is set when control byte i of the group equals b.
+    static uint32_t match_byte(const int8_t* ctrl, int8_t b) {
+#if defined(__AVX2__)
+        __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(b))));
+#elif defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(b))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(ctrl[i] == b) << i;
+        }
+        return mask;
+#endif
+    }
+    
+    // Full slots are the only control bytes with the sign bit set.
+    static uint32_t match_full(const int8_t* ctrl) {
+#if defined(__AVX2__)
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ctrl))));
+#elif defined(__SSE2__)
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kGroupWidth; ++i) {
+            mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+    
+    static uint32_t match_empty_or_deleted(const int8_t* ctrl) { return ~match_full(ctrl) & kGroupBits; }
+    
+    template <typename KeyEq>
+    static uint32_t find_in(const Table& table, uint32_t h, KeyEq& key_eq) {
+        size_t group = (h >> 7) & table.group_mask;
+        for (size_t step = 1;; ++step) {
+            const int8_t* ctrl = table.ctrl.get() + group * kGroupWidth;
+            for (uint32_t mask = match_byte(ctrl, fingerprint(h)); mask != 0; mask &= mask - 1) {
+                const Slot& slot = table.slots[group * kGroupWidth + __builtin_ctz(mask)];
+                if (slot.hash == h && key_eq(slot.id)) {
+                    return slot.id;
+                }
+            }
+            if (match_byte(ctrl, kEmpty) != 0) {
+                return kNotFound;
+            }
+            group = (group + step) & table.group_mask;
+        }
+    }
+    
+    template <typename Fn>
+    static void scan_home(const Table& table, size_t home, Fn& fn) {
+        size_t group = home;
+        for (size_t step = 1;; ++step) {
+            // An id homed here sits no further along the probe sequence than
+            // the first group with an empty slot, just as for find()
+            const int8_t* ctrl = table.ctrl.get() + group * kGroupWidth;
+            for (uint32_t mask = match_full(ctrl); mask != 0; mask &= mask - 1) {
+                const Slot& slot = table.slots[group * kGroupWidth + __builtin_ctz(mask)];
+                if (((slot.hash >> 7) & table.group_mask) == home) {
+                    fn(slot.id);
+                }
+            }
+            if (match_byte(ctrl, kEmpty) != 0) {
+                return;
+            }
+            group = (group + step) & table.group_mask;
+        }
+    }
+    
+    static size_t max_load(const Table& table) { return table.capacity() - table.capacity() / 8; }
+    static Table make_table(size_t groups);
+    static void place(Table& table, uint32_t h, uint32_t id);
+    static bool erase_from(Table& table, uint32_t h, uint32_t id);
+    void migrate(size_t groups);
+};
+
+using ValuePtr = std::shared_ptr<const std::string>;
+
+// Read-only, reference-counted handle to a stored value. The bytes stay valid
+// after the entry is overwritten, removed or evicted, until the handle is
+// released, so readers can use large values without copying them.
+class ValueRef {
+public:
+    ValueRef() = default;
+    explicit ValueRef(ValuePtr data) : data_(std::move(data)) {}
+    
+    explicit operator bool() const { return static_cast<bool>(data_); }
+    std::string_view view() const { return data_ ? std::string_view(*data_) : std::string_view(); }
+    const char* data() const { return data_ ? data_->data() : nullptr; }
+    size_t size() const { return data_ ? data_->size() : 0; }
+    std::string str() const { return std::string(view()); }
+    void reset() { data_.reset(); }
+    
+private:
+    ValuePtr data_;
+};
+
+// Size-class allocator for the key and short value bytes of cache entries.
+// Each class hands out fixed-size slots carved from 64 KiB pages, and freed
+// slots go on the class's free list for the next allocation of that size, so
+// churn reuses memory instead of scattering small blocks over the heap.
+// Requests above kMaxSlabSize fall back to the heap. Not thread safe; each
+// cache shard owns one and uses it under its lock.
+class SlabAllocator {
+public:
+    static constexpr size_t kPageSize = 64 * 1024;
+    static constexpr size_t kMaxSlabSize = 1024;
+    
+    SlabAllocator() = default;
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+    ~SlabAllocator() { clear(); }
+    
+    // Bytes allocate(size) actually takes: the size class's slot, or the
+    // requested size for an oversized block
+    static size_t slot_size(size_t size) {
+        if (size == 0) {
+            return 0;
+        }
+        return size > kMaxSlabSize ? size : kClassSizes[class_of(size)];
+    }
+    
+    // Returns null for size 0
+    char* allocate(size_t size);
+    void deallocate(char* p, size_t size);
+    // Releases every page at once; outstanding slots become invalid.
+    void clear();
+    // Exchanges all pages and slots with other in O(1)
+    void swap(SlabAllocator& other) noexcept;
+    
+    // Bytes callers currently hold, and bytes taken from the heap for them
+    // (whole pages plus oversized blocks). reserved / requested is the
+    // fragmentation ratio: size-class rounding, free slots and unused page
+    // tails all raise it above 1.
+    size_t requested_bytes() const { return requested_bytes_; }
+    size_t reserved_bytes() const { return reserved_bytes_; }
+    
+private:
+    static constexpr size_t kNumClasses = 18;
+    static constexpr uint16_t kClassSizes[kNumClasses] = {
+        8, 16, 24, 32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512, 640, 768, 1024
+    };
+    
+    struct SizeClass {
+        // Freed slots, linked through their first bytes
+        char* free_list = nullptr;
+        // Unused tail of the class's newest page
+        char* next = nullptr;
+        char* end = nullptr;
     };
     
-    using NodePtr = std::shared_ptr<Node>;
+    SizeClass classes_[kNumClasses];
+    std::vector<std::unique_ptr<char[]>> pages_;
+    // Oversized blocks by address, with their sizes, so clear() can free them
+    std::unordered_map<char*, size_t> large_blocks_;
+    size_t requested_bytes_ = 0;
+    size_t reserved_bytes_ = 0;
+    
+    static size_t class_of(size_t size) {
+        return std::lower_bound(kClassSizes, kClassSizes + kNumClasses, size) - kClassSizes;
+    }
+};
+
+// Store-wide clock for entry recency. A background thread advances it every
+// kTickInterval, so access paths read one relaxed atomic instead of calling
+// steady_clock::now(). Expiry deadlines still use steady_clock.
+class CoarseClock {
+public:
+    static constexpr std::chrono::milliseconds kTickInterval{10};
+    
+    CoarseClock();
+    ~CoarseClock();
+    CoarseClock(const CoarseClock&) = delete;
+    CoarseClock& operator=(const CoarseClock&) = delete;
+    
+    // Whole ticks since the clock started
+    uint32_t ticks() const { return ticks_.load(std::memory_order_relaxed); }
+    
+    // Periodic work run on the clock thread about every kTaskInterval, such
+    // as active expiry. Ticks stall while a task runs, so tasks must be
+    // short. remove_task() waits for a running task, so its owner can be
+    // destroyed right after.
+    static constexpr std::chrono::milliseconds kTaskInterval{100};
+    uint64_t add_task(std::function<void()> task);
+    void remove_task(uint64_t id);
+    
+private:
+    std::atomic<uint32_t> ticks_{0};
+    std::mutex tasks_mutex_;
+    std::vector<std::pair<uint64_t, std::function<void()>>> tasks_;
+    uint64_t next_task_id_ = 1;
+    std::chrono::steady_clock::time_point epoch_;
+    std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+// Background thread that destroys detached cache structures and large
+// values, so a lock holder only pays for moving them out. One per store,
+// shared by its shards.
+class Reclaimer {
+public:
+    Reclaimer();
+    // Frees whatever is still queued, then stops the thread
+    ~Reclaimer();
+    Reclaimer(const Reclaimer&) = delete;
+    Reclaimer& operator=(const Reclaimer&) = delete;
+    
+    // Queues garbage to be destroyed on the reclaimer thread; entries is how
+    // much it adds to the backlog until then
+    template <typename T>
+    void retire(T garbage, size_t entries) {
+        push(std::make_unique<Holder<T>>(std::move(garbage)), entries);
+    }
+    
+    // Entries queued but not freed yet
+    size_t backlog() const { return backlog_.load(std::memory_order_relaxed); }
+    
+private:
+    struct Garbage {
+        virtual ~Garbage() = default;
+    };
+    template <typename T>
+    struct Holder : Garbage {
+        explicit Holder(T v) : value(std::move(v)) {}
+        T value;
+    };
+    struct Item {
+        std::unique_ptr<Garbage> garbage;
+        size_t entries;
+    };
+    
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Item> queue_;
+    bool stopping_ = false;
+    std::atomic<size_t> backlog_{0};
+    std::thread thread_;
+    
+    void push(std::unique_ptr<Garbage> garbage, size_t entries);
+    void run();
+};
+
+// How an entry holds its value; see CacheEntry.
+enum class ValueEncoding : uint8_t {
+    Inline,
+    Shared,
+    Integer
+};
+
+struct CacheEntry {
+    // Values up to kInlineValueMax bytes are copied into a slab slot
+    // (inline_value); longer ones live in a shared buffer that readers pin
+    // instead of copying. Counters written by incr_by keep their number in
+    // integer and have neither.
+    static constexpr size_t kInlineValueMax = 256;
+    
+    // Access metadata packed into one word: bits 0-7 count accesses and
+    // saturate at 255, bit 8 is the CLOCK/SIEVE reference bit, and bits 9-31
+    // hold the coarse clock tick of the last access (wrapping). Atomic
+    // because the reference bit is set under the shared lock; every other
+    // change happens under the exclusive lock.
+    static constexpr uint32_t kAccessCountMask = 0xFF;
+    static constexpr uint32_t kReferencedBit = 1u << 8;
+    static constexpr int kTickShift = 9;
+    static constexpr uint32_t kTickMask = UINT32_MAX >> kTickShift;
+    
+    ValuePtr value;
+    char* inline_value = nullptr;
+    int64_t integer = 0;
+    // Changes on every write to the key, never repeats within a shard, and is
+    // never 0, so it serves as a compare-and-set token
+    uint64_t version = 0;
+    // time_point::max() when the entry never expires
+    std::chrono::steady_clock::time_point expires_at = std::chrono::steady_clock::time_point::max();
+    uint32_t inline_size = 0;
+    std::atomic<uint32_t> meta{0};
+    ValueEncoding encoding = ValueEncoding::Inline;
+    
+    uint32_t access_count() const { return meta.load(std::memory_order_relaxed) & kAccessCountMask; }
+    uint32_t last_access_tick() const { return meta.load(std::memory_order_relaxed) >> kTickShift; }
+    bool referenced() const { return (meta.load(std::memory_order_relaxed) & kReferencedBit) != 0; }
+    
+    // Counts an access at the given clock tick
+    void touch(uint32_t tick) {
+        uint32_t m = meta.load(std::memory_order_relaxed);
+        uint32_t count = m & kAccessCountMask;
+        count += count < kAccessCountMask ? 1 : 0;
+        meta.store(((tick & kTickMask) << kTickShift) | (m & kReferencedBit) | count, std::memory_order_relaxed);
+    }
+    // Moves the last access tick without counting an access
+    void set_last_access_tick(uint32_t tick) {
+        uint32_t m = meta.load(std::memory_order_relaxed);
+        meta.store(((tick & kTickMask) << kTickShift) | (m & ~(kTickMask << kTickShift)), std::memory_order_relaxed);
+    }
+    void set_access_count(uint32_t count) {
+        uint32_t m = meta.load(std::memory_order_relaxed);
+        meta.store((m & ~kAccessCountMask) | std::min(count, kAccessCountMask), std::memory_order_relaxed);
+    }
+    // Safe under the shared lock. Only writes when the bit changes, so hot
+    // keys keep their cache line shared.
+    void mark_referenced() {
+        if (!referenced()) {
+            meta.fetch_or(kReferencedBit, std::memory_order_relaxed);
+        }
+    }
+    void clear_referenced() { meta.fetch_and(~kReferencedBit, std::memory_order_relaxed); }
+};
+
+// Remaining lifetime reported by ttl() for keys without an expiry.
+constexpr std::chrono::milliseconds kNoExpiry{-1};
+
+// Which entries the cache gives up when it is full.
+enum class EvictionPolicyType {
+    // Recency list; RecencyMode selects exact LRU or CLOCK second chance.
+    LRU,
+    // Small LRU admission window in front of a segmented main space. A
+    // count-min frequency sketch decides whether an entry leaving the window
+    // may displace the main space's victim, so one-off scans cannot flush
+    // the hot set.
+    WTinyLFU,
+    // Segmented LRU: entries are promoted from a probation segment to a
+    // protected one once their access_count shows a repeat hit.
+    SLRU,
+    // Adaptive replacement: recency and frequency lists whose split adapts
+    // using ghost lists of recently evicted keys.
+    ARC,
+    // Insertion-ordered list with a visited bit per entry and a moving
+    // eviction hand. Hits never reorder, so they run under the shared lock.
+    SIEVE
+};
+
+const char* eviction_policy_name(EvictionPolicyType type);
+bool parse_eviction_policy(std::string_view name, EvictionPolicyType& type);
+
+// Why an entry left the cache, as counted per shard and passed to the
+// eviction callback. clear() and clear_async() drop entries without
+// reporting them.
+enum class EvictionReason {
+    // The entry count reached capacity
+    Capacity,
+    // The memory budget was exceeded
+    Memory,
+    // Its TTL ran out
+    Expired,
+    // remove(), remove_async() or expire() with a non-positive TTL
+    Explicit
+};
+constexpr size_t kEvictionReasons = 4;
+
+const char* eviction_reason_name(EvictionReason reason);
+
+// Receives each entry as it leaves the cache, e.g. for write-behind. It runs
+// under the shard's exclusive lock, so it must be quick and must not call
+// back into the cache; hand slow work to another thread.
+using EvictionCallback = std::function<void(std::string_view key, const ValuePtr& value, EvictionReason reason)>;
+
+struct CacheOptions {
+    // Maximum number of entries; 0 means no entry limit (requires a memory budget).
+    size_t capacity = 1000;
+    RecencyMode recency = RecencyMode::Strict;
+    // Budget for key bytes, value bytes and per-entry overhead; 0 disables it.
+    size_t max_memory_bytes = 0;
+    EvictionPolicyType policy = EvictionPolicyType::LRU;
+    // Keep keys in a sorted index as well, for prefix and range scans.
+    bool ordered_index = false;
+    // Recency clock shared by a store's shards; a cache without one starts its own
+    std::shared_ptr<CoarseClock> clock;
+    // Frees for clear_async/remove_async; a cache without one starts its own
+    // on first use
+    std::shared_ptr<Reclaimer> reclaimer;
+    // Optional; see EvictionCallback
+    EvictionCallback on_evict;
+    // Record wait and hold times of the cache lock; see lock_stats()
+    bool lock_stats = false;
+};
+
+// One cache entry. The key is stored once, in a slab slot owned by the node;
+// the index only holds node ids. prev/next/segment belong to the eviction
+// policy and the timer_* fields to the expiry TimingWheel.
+struct CacheNode {
+    static constexpr uint16_t kNoTimer = UINT16_MAX;
+    
+    char* key_data = nullptr;
+    uint64_t hash = 0;
+    CacheEntry entry;
+    uint32_t key_size = 0;
+    uint32_t prev = 0;
+    uint32_t next = 0;
+    uint32_t timer_prev = 0;
+    uint32_t timer_next = 0;
+    uint16_t timer_slot = kNoTimer;
+    uint8_t segment = 0;
+    
+    std::string_view key() const { return std::string_view(key_data, key_size); }
+};
+
+// Nodes live in fixed-size chunks that never move, so a node is named by a
+// 32-bit id and lists link ids instead of pointers. Released ids are reused.
+class NodeArena {
+public:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    
+    CacheNode& operator[](uint32_t id) { return chunks_[id / kNodesPerChunk][id % kNodesPerChunk]; }
+    const CacheNode& operator[](uint32_t id) const { return chunks_[id / kNodesPerChunk][id % kNodesPerChunk]; }
+    
+    uint32_t allocate();
+    void release(uint32_t id);
+    void clear();
+    size_t allocated() const { return allocated_; }
+    
+private:
+    static constexpr uint32_t kNodesPerChunk = 1024;
+    
+    std::vector<std::unique_ptr<CacheNode[]>> chunks_;
+    uint32_t allocated_ = 0;
+    uint32_t free_list_ = kNil;
+};
+
+// Doubly linked list of node ids threaded through CacheNode::prev/next.
+class NodeList {
+public:
+    explicit NodeList(NodeArena& nodes) : nodes_(&nodes) {}
+    
+    uint32_t front() const { return head_; }
+    uint32_t back() const { return tail_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
     
-    std::unordered_map<std::string, NodePtr> cache_map;
-    NodePtr head, tail;
+    void push_front(uint32_t id) {
+        CacheNode& n = (*nodes_)[id];
+        n.prev = NodeArena::kNil;
+        n.next = head_;
+        if (head_ != NodeArena::kNil) {
+            (*nodes_)[head_].prev = id;
+        } else {
+            tail_ = id;
+        }
+        head_ = id;
+        size_++;
+    }
+    
+    void remove(uint32_t id) {
+        CacheNode& n = (*nodes_)[id];
+        if (n.prev != NodeArena::kNil) {
+            (*nodes_)[n.prev].next = n.next;
+        } else {
+            head_ = n.next;
+        }
+        if (n.next != NodeArena::kNil) {
+            (*nodes_)[n.next].prev = n.prev;
+        } else {
+            tail_ = n.prev;
+        }
+        size_--;
+    }
+    
+    void move_to_front(uint32_t id) {
+        if (id != head_) {
+            remove(id);
+            push_front(id);
+        }
+    }
+    
+    void clear() {
+        head_ = tail_ = NodeArena::kNil;
+        size_ = 0;
+    }
+    // Follows the nodes to another arena they were swapped into
+    void rebind(NodeArena& nodes) { nodes_ = &nodes; }
+    
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (uint32_t id = head_; id != NodeArena::kNil; id = (*nodes_)[id].next) {
+            fn(id);
+        }
+    }
+    
+private:
+    NodeArena* nodes_;
+    uint32_t head_ = NodeArena::kNil;
+    uint32_t tail_ = NodeArena::kNil;
+    size_t size_ = 0;
+};
+
+// Hierarchical timing wheel of node ids keyed by CacheEntry::expires_at.
+// Level l has 64 slots of 64^l one-millisecond ticks. A timer is filed at
+// the lowest level whose span covers its deadline and cascades down as the
+// wheel turns, so scheduling, cancelling and expiring a key are O(1)
+// amortized. Stretches with no timers are skipped a level at a time.
+class TimingWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    explicit TimingWheel(NodeArena& nodes);
+    
+    // Files id by its entry's expires_at; id must not already be scheduled.
+    void schedule(uint32_t id);
+    void cancel(uint32_t id);
+    // Turns the wheel to now and appends the ids whose deadline has passed.
+    void advance(Clock::time_point now, std::vector<uint32_t>& due);
+    void clear();
+    // Safe to read without the owner's lock, to skip locking an empty wheel
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+    
+private:
+    static constexpr size_t kLevels = 6;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+    
+    NodeArena* nodes_;
+    Clock::time_point epoch_;
+    uint64_t now_ = 0;
+    // Written under the owner's exclusive lock only
+    std::atomic<size_t> size_{0};
+    size_t level_size_[kLevels] = {};
+    uint32_t heads_[kLevels * kSlots];
+    
+    uint64_t deadline_tick(uint32_t id) const;
+    void file(uint32_t id, uint64_t deadline);
+    void unlink(uint32_t id);
+};
+
+// Strategy that decides which entry to evict. Policies track entries by node
+// id and are called under the cache's exclusive lock, except
+// on_shared_access(), which runs under the shared lock when
+// concurrent_hits() is true and must only touch atomics.
+class EvictionPolicy {
+public:
+    virtual ~EvictionPolicy() = default;
+    
+    virtual bool concurrent_hits() const { return false; }
+    virtual void on_insert(uint32_t id) = 0;
+    virtual void on_access(uint32_t id) = 0;
+    virtual void on_shared_access(uint32_t id) { (void)id; }
+    virtual void on_remove(uint32_t id) = 0;
+    // Picks a victim and unlinks it; returns NodeArena::kNil when empty.
+    virtual uint32_t evict() = 0;
+    virtual void clear() = 0;
+    // Points the policy at another arena holding the same nodes, as when
+    // clear_async swaps the shard's arena out from under it.
+    virtual void rebind(NodeArena& nodes) = 0;
+    // Visits tracked entries, most worth keeping first.
+    virtual void for_each(const std::function<void(uint32_t)>& fn) const = 0;
+};
+
+// options.clock must be set.
+std::unique_ptr<EvictionPolicy> make_eviction_policy(const CacheOptions& options, NodeArena& nodes);
+
+// One entry's metadata as reported by inspect(). idle is measured with the
+// coarse clock, so it is accurate to about CoarseClock::kTickInterval and is
+// only updated by accesses under the exclusive lock (shared-lock hits just
+// set referenced).
+struct EntryInfo {
+    ValueEncoding encoding = ValueEncoding::Inline;
+    size_t value_size = 0;
+    uint64_t version = 0;
+    // Saturates at 255
+    uint32_t access_count = 0;
+    bool referenced = false;
+    // Wraps: CacheEntry keeps 23 bits of the last access tick, so a key idle
+    // for more than 2^23 ticks (about 23 hours) reports its idle time modulo
+    // that span
+    std::chrono::milliseconds idle{0};
+    // kNoExpiry when the key has no TTL
+    std::chrono::milliseconds ttl = kNoExpiry;
+};
+
+// One key of a batch operation, hashed up front. pos is the key's position
+// in the caller's request and indexes the batch's values and results.
+struct BatchKey {
+    std::string_view key;
+    uint64_t hash;
+    uint32_t pos;
+};
+
+// Key and pinned value returned by ordered scans.
+using KeyValueList = std::vector<std::pair<std::string, ValueRef>>;
+
+// Acquisitions of one lock in one mode. An acquisition is contended when it
+// could not take the lock without blocking; wait_ns is the time those spent
+// blocked and hold_ns the time from acquisition to unlock.
+struct LockModeStats {
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> wait_ns{0};
+    std::atomic<uint64_t> hold_ns{0};
+    
+    void copy_from(const LockModeStats& other) {
+        acquisitions = other.acquisitions.load(std::memory_order_relaxed);
+        contended = other.contended.load(std::memory_order_relaxed);
+        wait_ns = other.wait_ns.load(std::memory_order_relaxed);
+        hold_ns = other.hold_ns.load(std::memory_order_relaxed);
+    }
+    void reset() {
+        acquisitions = 0;
+        contended = 0;
+        wait_ns = 0;
+        hold_ns = 0;
+    }
+};
+
+struct LockStats {
+    LockModeStats shared;
+    LockModeStats exclusive;
+};
+
+// std::shared_mutex that can record LockStats. Instrumented, each acquisition
+// first tries without blocking and only reads the clock around the blocking
+// wait if that fails, plus once at acquisition and once at unlock for the
+// hold time. Uninstrumented, it forwards straight to the mutex.
+class InstrumentedSharedMutex {
+public:
+    explicit InstrumentedSharedMutex(bool instrumented = false) : instrumented_(instrumented) {}
+    InstrumentedSharedMutex(const InstrumentedSharedMutex&) = delete;
+    InstrumentedSharedMutex& operator=(const InstrumentedSharedMutex&) = delete;
+    
+    void lock();
+    bool try_lock();
+    void unlock();
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+    
+    bool instrumented() const { return instrumented_; }
+    const LockStats& stats() const { return stats_; }
+    void reset_stats() {
+        stats_.shared.reset();
+        stats_.exclusive.reset();
+    }
+    
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    std::shared_mutex mutex_;
+    const bool instrumented_;
+    // Written by the exclusive holder only
+    Clock::time_point exclusive_since_;
+    LockStats stats_;
+};
+
+class LRUCache {
+private:
+    static constexpr uint32_t kNil = NodeArena::kNil;
+    
+    // The options this cache was built with, clock included; set by the
+    // constructor and read without the lock afterwards
+    CacheOptions options_;
+    std::shared_ptr<CoarseClock> clock_;
+    std::shared_ptr<Reclaimer> reclaimer_;
+    FlatIndex index_;
+    NodeArena nodes_;
+    SlabAllocator slab_;
+    // Optional sorted view of the live keys, viewing each node's key bytes
+    std::unique_ptr<std::map<std::string_view, uint32_t>> ordered_;
+    TimingWheel wheel_;
+    std::vector<uint32_t> expired_;
+    std::unique_ptr<EvictionPolicy> policy_;
+    EvictionCallback on_evict_;
+    // Indexed by EvictionReason; written under the exclusive lock, read without it
+    std::atomic<uint64_t> eviction_counts_[kEvictionReasons] = {};
     size_t capacity;
     size_t current_size;
-    mutable std::shared_mutex mutex_;
+    size_t max_memory_bytes_;
+    size_t used_bytes_ = 0;
+    uint64_t last_version_ = 0;
+    RecencyMode recency_;
+    EvictionPolicyType policy_type_;
+    mutable InstrumentedSharedMutex mutex_;
+    // Clock task advancing the timing wheel between writes
+    uint64_t expiry_task_ = 0;
+    
+    // Index bytes per entry: an 8-byte slot and its control byte at the
+    // table's maximum load
+    static constexpr size_t kIndexSlotCharge = 12;
+    // Extra charge per entry for an ordered index node: three pointers and a
+    // color, the key view and id, and the allocator's header
+    static constexpr size_t kOrderedEntryCharge = 64;
+    // A shared value's string object plus its control block and allocator
+    // headers, on top of the heap buffer
+    static constexpr size_t kSharedValueOverhead = sizeof(std::string) + 32;
+    
+    // Bytes charged against the memory budget for an entry apart from its
+    // value: the node, its index slot, the key's slab slot and, with the
+    // ordered index, its tree node.
+    size_t node_charge(size_t key_size) const {
+        return sizeof(CacheNode) + kIndexSlotCharge + SlabAllocator::slot_size(key_size) +
+               (ordered_ ? kOrderedEntryCharge : 0);
+    }
+    // Bytes charged for a value of size bytes stored as encoding: its slab
+    // slot when inline, the buffer and string with its control block when
+    // shared, nothing for an integer kept in the entry.
+    static size_t value_charge(size_t size, ValueEncoding encoding) {
+        switch (encoding) {
+        case ValueEncoding::Inline: return SlabAllocator::slot_size(size);
+        case ValueEncoding::Shared: return size + kSharedValueOverhead;
+        default: return 0;
+        }
+    }
     
-    void move_to_front(NodePtr node);
-    void remove_node(NodePtr node);
-    NodePtr remove_tail();
+    // Value bytes held outside the node; integer-encoded counters have none
+    static size_t stored_size(const CacheEntry& entry) {
+        switch (entry.encoding) {
+        case ValueEncoding::Inline: return entry.inline_size;
+        case ValueEncoding::Shared: return entry.value->size();
+        default: return 0;
+        }
+    }
+    static size_t value_charge(const CacheEntry& entry) {
+        return value_charge(stored_size(entry), entry.encoding);
+    }
+    // The entry's value as text; integer-encoded counters are formatted into
+    // digits, which must hold 20 characters
+    static std::string_view value_view(const CacheEntry& entry, char* digits);
+    // The value as a shareable buffer: shared values are pinned, others copied
+    static ValuePtr value_of(const CacheEntry& entry);
+    // Shared buffer for a value too long to store inline, built before the
+    // lock is taken; null for short values
+    static ValuePtr share_if_long(std::string_view value) {
+        return value.size() > CacheEntry::kInlineValueMax ? std::make_shared<const std::string>(value) : nullptr;
+    }
+    
+    // Replaces the entry's value with value, inline or as shared (which holds
+    // the same bytes, or is null for short values). The old value goes to
+    // retired unless retired is in use. Keeps used_bytes_ current.
+    void assign_value(CacheEntry& entry, std::string_view value, ValuePtr shared, ValuePtr& retired);
+    void release_value(CacheEntry& entry, ValuePtr& retired);
+    
+    uint32_t find_node(std::string_view key, uint64_t hash) const;
+    // Inserts a node holding the integer 0; callers then assign its value
+    uint32_t insert_node(std::string_view key, uint64_t hash);
+    // Drops a node the policy no longer tracks. Its value moves into retired so
+    // the caller can release it after unlocking, unless retired is in use.
+    void free_node(uint32_t id, ValuePtr& retired);
+    // free_node for an entry leaving for reason: counts it and calls on_evict_ first
+    void evict_node(uint32_t id, EvictionReason reason, ValuePtr& retired);
+    bool evict_one(EvictionReason reason, ValuePtr& retired);
+    // Evicts for the memory budget until incoming more bytes fit; returns
+    // false if keep, an entry about to be rewritten, was among the victims
+    bool make_room(size_t incoming, uint32_t keep, ValuePtr& retired);
+    void reset_entries();
+    // What clear_async() swaps out for the reclaimer to destroy
+    struct DetachedEntries;
+    Reclaimer& reclaimer_locked();
+    
+    // Only reads the clock for entries that have an expiry
+    static bool is_expired(const CacheEntry& entry) {
+        return entry.expires_at != std::chrono::steady_clock::time_point::max() &&
+               entry.expires_at <= std::chrono::steady_clock::now();
+    }
+    // Like find_node, but an entry past its expiry is reclaimed and reported missing.
+    uint32_t find_live_node(std::string_view key, uint64_t hash, ValuePtr& retired);
+    void set_expiry(uint32_t id, std::chrono::steady_clock::time_point expires_at);
+    // Reclaims every entry whose timer has fired; returns how many.
+    size_t expire_due(ValuePtr& retired);
+    // Clock task: expire_due under the exclusive lock, so expired entries
+    // stop holding memory during read-only stretches
+    void expire_in_background();
+    void put_until(std::string_view key, std::string_view value, ValuePtr shared,
+                   std::chrono::steady_clock::time_point expires_at);
+    // Stores value under the exclusive lock; returns true if the key was new.
+    bool put_locked(std::string_view key, uint64_t hash, std::string_view value, ValuePtr shared,
+                    std::chrono::steady_clock::time_point expires_at, ValuePtr& retired);
+    // incr_by/decr_by in one locked, overflow-checked step
+    int64_t add_to_counter(std::string_view key, int64_t delta, bool subtract);
+    // Looks keys up under the lock get_batch needs and calls
+    // on_hit(pos, entry) for each live one
+    template <typename OnHit>
+    size_t lookup_batch(const BatchKey* keys, size_t count, OnHit&& on_hit);
     
 public:
-    explicit LRUCache(size_t cap);
+    explicit LRUCache(size_t cap, RecencyMode recency = RecencyMode::Strict);
+    explicit LRUCache(const CacheOptions& options);
+    ~LRUCache();
     
-    bool get(const std::string& key, std::string& value);
-    void put(const std::string& key, const std::string& value);
-    bool remove(const std::string& key);
+    bool get(std::string_view key, std::string& value);
+    bool get(std::string_view key, std::string& value, uint64_t& version);
+    ValueRef get_ref(std::string_view key);
+    void put(std::string_view key, std::string_view value);
+    // Stores an already built value, sharing its bytes with the caller.
+    void put(std::string_view key, ValuePtr value);
+    // Stores the value and expires it after ttl, which must be positive. A
+    // ttl past the end of the clock's range means no expiry.
+    void put(std::string_view key, std::string_view value, std::chrono::milliseconds ttl);
+    bool remove(std::string_view key);
+    // Sets a key's time to live; a non-positive ttl deletes it and one past
+    // the clock's range removes its expiry. Returns false if the key is missing.
+    bool expire(std::string_view key, std::chrono::milliseconds ttl);
+    // Remaining time to live, or kNoExpiry; returns false if the key is missing.
+    bool ttl(std::string_view key, std::chrono::milliseconds& remaining) const;
+    // Reports the key's metadata without counting an access; returns false
+    // if the key is missing.
+    bool inspect(std::string_view key, EntryInfo& info) const;
+    // Reclaims expired entries now instead of on the next write; returns how many.
+    size_t purge_expired();
+    // Writes value only if the key's version is still expected_version (0:
+    // only if the key is absent). Like put, it clears the key's TTL.
+    bool compare_and_set(std::string_view key, uint64_t expected_version, std::string_view value);
+    // Adds delta to a counter in one locked step and returns the new value.
+    // A missing key counts from 0. Decimal text is converted to a native
+    // integer kept in the entry; other values throw std::invalid_argument
+    // and overflow throws std::overflow_error. The key's TTL is kept.
+    int64_t incr_by(std::string_view key, int64_t delta);
+    int64_t decr_by(std::string_view key, int64_t delta);
     void clear();
+    
+    // Lazy freeing. clear_async swaps every structure for an empty one in
+    // O(1) under the lock and leaves destroying the old entries to the
+    // reclaimer thread. remove_async does the same for a removed value of
+    // at least kLazyFreeBytes; smaller ones are freed in place.
+    static constexpr size_t kLazyFreeBytes = 64 * 1024;
+    void clear_async();
+    bool remove_async(std::string_view key);
+    
+    // Batch forms behind KVStore::multi_get/multi_put: the lock is taken once
+    // for all keys and their index groups are prefetched before probing.
+    // results, versions and values are indexed by BatchKey::pos; versions
+    // may be null. get_batch returns the number of hits.
+    size_t get_batch(const BatchKey* keys, size_t count, ValueRef* results, uint64_t* versions = nullptr);
+    void put_batch(const BatchKey* keys, size_t count, const std::string_view* values);
+    
+    // Appends live entries with keys in [start, end) in key order, at most
+    // limit of them (0: no limit); an empty end means no upper bound. Needs
+    // the ordered index and throws std::logic_error without it.
+    void range(std::string_view start, std::string_view end, size_t limit, KeyValueList& out) const;
+    bool has_ordered_index() const { return ordered_ != nullptr; }
+    
+    // Incremental iteration: appends the live entries of up to count index
+    // groups at cursor (start with 0) and returns the next cursor, 0 when
+    // done. The shared lock is held only for the call. Keys present for the
+    // whole iteration are returned at least once, even across a resize.
+    uint64_t scan(uint64_t cursor, size_t count, KeyValueList& out) const;
+    
     size_t size() const;
     bool empty() const;
+    RecencyMode recency_mode() const { return recency_; }
+    EvictionPolicyType policy_type() const { return policy_type_; }
+    size_t memory_usage() const;
+    size_t max_memory_bytes() const { return max_memory_bytes_; }
+    // Entries that left for reason since construction or the last reset
+    uint64_t eviction_count(EvictionReason reason) const {
+        return eviction_counts_[static_cast<size_t>(reason)].load(std::memory_order_relaxed);
+    }
+    void reset_eviction_counts();
+    // Acquisitions of this cache's lock; all zero unless built with
+    // CacheOptions::lock_stats
+    const LockStats& lock_stats() const { return mutex_.stats(); }
+    void reset_lock_stats() { mutex_.reset_stats(); }
+    // Slab bytes held by callers and reserved from the heap; see SlabAllocator
+    void slab_usage(size_t& requested_bytes, size_t& reserved_bytes) const;
     
     // Snapshot operations
     void save_snapshot(const std::string& filename) const;
     bool load_snapshot(const std::string& filename);
+    
+    // Writes every entry in snapshot record format and returns the count written.
+    // Used by KVStore to combine several shards into one snapshot file.
+    uint32_t write_entries(std::ostream& out) const;
+};
+
+// Per-thread slots for StripedCounter and LatencyHistogram. Threads take
+// slots round-robin on first use; with more threads than slots a few share
+// one, which stays correct and only costs contention.
+constexpr size_t kThreadStripes = 64;
+
+inline size_t thread_stripe() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % kThreadStripes;
+    return index;
+}
+
+// Event counter split over cache-line-padded stripes. Each thread adds to
+// its own stripe, so hot-path increments from many cores don't bounce one
+// line between them; load() sums the stripes and is only as current as the
+// relaxed adds it races with.
+class StripedCounter {
+public:
+    static constexpr size_t kStripes = kThreadStripes;
+    static constexpr size_t kCacheLine = 64;
+    
+    StripedCounter() = default;
+    StripedCounter(const StripedCounter&) = delete;
+    StripedCounter& operator=(const StripedCounter&) = delete;
+    
+    void add(uint64_t n) { stripes_[thread_stripe()].value.fetch_add(n, std::memory_order_relaxed); }
+    StripedCounter& operator+=(uint64_t n) { add(n); return *this; }
+    void operator++(int) { add(1); }
+    
+    uint64_t load() const {
+        uint64_t total = 0;
+        for (const auto& s : stripes_) {
+            total += s.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+    operator uint64_t() const { return load(); }
+    
+    void reset() {
+        for (auto& s : stripes_) {
+            s.value.store(0, std::memory_order_relaxed);
+        }
+    }
+    
+private:
+    struct alignas(kCacheLine) Stripe {
+        std::atomic<uint64_t> value{0};
+    };
+    
+    Stripe stripes_[kStripes];
+};
+
+// Operations with their own latency histogram in PerformanceMetrics.
+enum class OpType {
+    Get,
+    Put,
+    Del
+};
+constexpr size_t kOpTypes = 3;
+
+const char* op_type_name(OpType type);
+
+// Log-linear (HDR-style) histogram of nanosecond latencies. Each power of
+// two is split into kSubBuckets linear buckets, so a reported value is
+// within 1/kSubBuckets (about 3%) of the recorded one; values above
+// kMaxValue land in the top bucket. Every thread records into its own
+// lazily allocated bucket array and reads merge them.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 5;
+    static constexpr uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+    static constexpr unsigned kMaxValueBits = 40;
+    static constexpr uint64_t kMaxValue = (uint64_t(1) << kMaxValueBits) - 1;
+    static constexpr size_t kBuckets = (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+    
+    LatencyHistogram() = default;
+    ~LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    
+    void record(uint64_t ns) {
+        Buckets* buckets = stripes_[thread_stripe()].load(std::memory_order_acquire);
+        if (!buckets) {
+            buckets = allocate_stripe();
+        }
+        buckets->counts[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    // Merged view of every thread's buckets, taken once for several queries
+    struct Snapshot {
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        
+        // Highest value in the bucket holding the p-th percentile (0-100)
+        // sample; 0 when empty
+        uint64_t percentile(double p) const;
+    };
+    Snapshot snapshot() const;
+    uint64_t count() const { return snapshot().total; }
+    uint64_t percentile(double p) const { return snapshot().percentile(p); }
+    // Zeroes the buckets in place; safe while other threads record
+    void reset();
+    
+    // Values below 2 * kSubBuckets get a bucket each; above that, bucket i
+    // covers [bucket_floor(i), bucket_floor(i + 1))
+    static size_t bucket_index(uint64_t value) {
+        value = std::min(value, kMaxValue);
+        if (value < 2 * kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        unsigned shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+        return static_cast<size_t>(shift * kSubBuckets + (value >> shift));
+    }
+    static uint64_t bucket_floor(size_t index) {
+        if (index < 2 * kSubBuckets) {
+            return index;
+        }
+        unsigned shift = static_cast<unsigned>(index / kSubBuckets) - 1;
+        return (index - shift * kSubBuckets) << shift;
+    }
+    
+private:
+    struct Buckets {
+        std::atomic<uint64_t> counts[kBuckets] = {};
+    };
+    
+    Buckets* allocate_stripe();
+    
+    std::atomic<Buckets*> stripes_[kThreadStripes] = {};
 };
 
 struct PerformanceMetrics {
-    std::atomic<uint64_t> total_operations{0};
-    std::atomic<uint64_t> cache_hits{0};
-    std::atomic<uint64_t> cache_misses{0};
+    // Bumped on every operation, so striped rather than one shared atomic each
+    StripedCounter total_operations;
+    StripedCounter cache_hits;
+    StripedCounter cache_misses;
+    // Read-through loads by KVStore::get_or_load: loader calls, their total
+    // latency, and misses that waited on another thread's load instead
+    std::atomic<uint64_t> loads{0};
+    std::atomic<uint64_t> load_time_ns{0};
+    std::atomic<uint64_t> coalesced_waits{0};
+    // Gauges refreshed from the shards by KVStore::get_metrics(); the slab
+    // pair is summed over every shard's SlabAllocator
+    std::atomic<uint64_t> memory_used_bytes{0};
+    std::atomic<uint64_t> slab_requested_bytes{0};
+    std::atomic<uint64_t> slab_reserved_bytes{0};
+    // Sampled latencies of single-key operations, indexed by OpType; see
+    // KVStoreOptions::latency_sample_every. Batches are not recorded.
+    LatencyHistogram latency[kOpTypes];
+    // One per shard, refreshed by KVStore::get_metrics() when
+    // KVStoreOptions::lock_stats is set
+    std::vector<LockStats> shard_locks;
+    // Entries detached by clear_async/remove_async and not yet freed
+    std::atomic<uint64_t> reclaim_backlog{0};
+    // Shard eviction counts indexed by EvictionReason; evictions is the
+    // capacity and memory pressure share of them
+    std::atomic<uint64_t> evictions_by_reason[kEvictionReasons] = {};
     std::atomic<uint64_t> evictions{0};
     std::chrono::steady_clock::time_point start_time;
     
     PerformanceMetrics() : start_time(std::chrono::steady_clock::now()) {}
     
+    void reset() {
+        total_operations.reset();
+        cache_hits.reset();
+        cache_misses.reset();
+        loads = 0;
+        load_time_ns = 0;
+        coalesced_waits = 0;
+        for (auto& histogram : latency) {
+            histogram.reset();
+        }
+        start_time = std::chrono::steady_clock::now();
+    }
+    
+    double average_load_latency_us() const {
+        uint64_t count = loads.load();
+        return count > 0 ? static_cast<double>(load_time_ns.load()) / count / 1000.0 : 0.0;
+    }
+    
+    // Slab bytes reserved per byte held; 1.0 means no fragmentation
+    double fragmentation_ratio() const {
+        uint64_t requested = slab_requested_bytes.load();
+        return requested > 0 ? static_cast<double>(slab_reserved_bytes.load()) / requested : 1.0;
+    }
+    
     double hit_rate() const {
         uint64_t hits = cache_hits.load();
         uint64_t total = hits + cache_misses.load();
@@ -80,33 +1235,145 @@ struct PerformanceMetrics {
     }
 };
 
+struct KVStoreOptions {
+    size_t capacity = 1000;
+    std::string snapshot_file;
+    size_t num_shards = 1;
+    RecencyMode recency = RecencyMode::Strict;
+    // Total byte budget split evenly across shards; 0 disables it. With a
+    // budget set, capacity may be 0 to drop the entry-count limit.
+    size_t max_memory_bytes = 0;
+    EvictionPolicyType policy = EvictionPolicyType::LRU;
+    // Maintain a sorted key index in every shard to serve scan() and range().
+    bool ordered_index = false;
+    // Called for every entry any shard evicts; see EvictionCallback
+    EvictionCallback on_evict = nullptr;
+    // Time one in this many GET/PUT/DEL calls per thread into
+    // PerformanceMetrics::latency; 1 times all of them, 0 none. Each timed
+    // call reads the clock twice.
+    uint32_t latency_sample_every = 16;
+    // Instrument every shard's lock; see PerformanceMetrics::shard_locks
+    bool lock_stats = false;
+};
+
 class KVStore {
 private:
-    std::unique_ptr<LRUCache> cache_;
+    // Ticks the recency of every shard's entries and runs their active expiry
+    std::shared_ptr<CoarseClock> clock_;
+    // Frees what every shard's clear_async/remove_async detaches
+    std::shared_ptr<Reclaimer> reclaimer_;
+    // Each shard is an independent LRUCache with its own lock and an equal
+    // share of the total capacity; keys are routed by hash.
+    std::vector<std::unique_ptr<LRUCache>> shards_;
     mutable PerformanceMetrics metrics_;
     std::string snapshot_file_;
+    uint32_t latency_sample_every_;
+    // Loads in flight for get_or_load, keyed by key; later misses wait on
+    // the same future instead of calling their loader. One per shard, so
+    // misses on different shards never wait on each other.
+    struct PendingLoads {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_future<ValuePtr>> loads;
+    };
+    std::vector<std::unique_ptr<PendingLoads>> loads_;
+    
+    size_t shard_index(uint64_t hash) const;
+    LRUCache& shard_for(std::string_view key) const { return *shards_[shard_index(hash_key(key))]; }
+    // Hashes every key of a batch and orders it by shard: shard s owns
+    // batch[offsets[s], offsets[s + 1]).
+    void plan_batch(std::vector<BatchKey>& batch, std::vector<uint32_t>& offsets) const;
+    // Merges every shard's entries in [start, end) (empty end: unbounded).
+    KeyValueList collect_range(std::string_view start, std::string_view end, size_t limit) const;
     
 public:
-    explicit KVStore(size_t capacity, const std::string& snapshot_file = "");
+    explicit KVStore(size_t capacity, const std::string& snapshot_file = "", size_t num_shards = 1);
+    explicit KVStore(const KVStoreOptions& options);
     ~KVStore();
     
-    // Core operations
-    bool get(const std::string& key, std::string& value);
-    void put(const std::string& key, const std::string& value);
-    bool remove(const std::string& key);
+    // Core operations. Keys are taken by string_view so lookups never
+    // allocate; only inserting a new key copies its bytes.
+    bool get(std::string_view key, std::string& value);
+    void put(std::string_view key, std::string_view value);
+    bool remove(std::string_view key);
     void clear();
     
+    // Like remove and clear, but the freeing happens on a background
+    // reclaimer thread (see LRUCache::clear_async); the backlog shows up as
+    // PerformanceMetrics::reclaim_backlog.
+    bool remove_async(std::string_view key);
+    void clear_async();
+    
+    // Optimistic concurrency: get returns the entry's version, and
+    // compare_and_set writes only if the version is unchanged (expected
+    // version 0 means the key must be absent). Retry on false.
+    bool get(std::string_view key, std::string& value, uint64_t& version);
+    bool compare_and_set(std::string_view key, uint64_t expected_version, std::string_view value);
+    
+    // Counters, updated under one shard lock and stored as native integers.
+    int64_t incr_by(std::string_view key, int64_t delta);
+    int64_t decr_by(std::string_view key, int64_t delta);
+    
+    // Expiry. A plain put clears a key's TTL. Expired keys read as missing
+    // and are reclaimed on access or by their shard's timing wheel, which
+    // turns on writes, on purge_expired() and every
+    // CoarseClock::kTaskInterval on the clock thread. A TTL past the end of
+    // the clock's range means no expiry.
+    void put(std::string_view key, std::string_view value, std::chrono::milliseconds ttl);
+    bool expire(std::string_view key, std::chrono::milliseconds ttl);
+    bool ttl(std::string_view key, std::chrono::milliseconds& remaining);
+    size_t purge_expired();
+    
+    // Introspection: the key's encoding, version, access count, idle time
+    // and TTL, without counting as an access. False if the key is missing.
+    bool inspect(std::string_view key, EntryInfo& info);
+    
+    // Zero-copy read: returns a pinned handle to the value, empty on a miss.
+    ValueRef get_ref(std::string_view key);
+    
+    // Read-through get. On a miss, loader(key) produces the value, which is
+    // cached and returned. Concurrent misses on one key share a single
+    // loader call; if it throws, every waiter sees the exception. The
+    // loader must not call get_or_load for the same key.
+    ValueRef get_or_load(std::string_view key, const std::function<std::string(std::string_view)>& loader);
+    
+    // Batch operations. Keys are grouped by shard so each shard's lock is
+    // taken once per batch, and metrics are updated once per batch.
+    // multi_get returns one handle per key, empty for misses.
+    std::vector<ValueRef> multi_get(const std::vector<std::string_view>& keys);
+    void multi_put(const std::vector<std::pair<std::string_view, std::string_view>>& entries);
+    
+    // Ordered queries over all shards, in key order; they require
+    // KVStoreOptions::ordered_index. scan returns keys starting with
+    // prefix and range keys in [start, end), where an empty end means no
+    // upper bound; limit 0 means no limit.
+    KeyValueList scan(std::string_view prefix, size_t limit = 0) const;
+    KeyValueList range(std::string_view start, std::string_view end, size_t limit = 0) const;
+    
+    // Redis-style incremental SCAN over all shards: appends the entries of
+    // about count index groups and returns the cursor for the next call (0
+    // when done; start with 0). Each call holds one shard's lock briefly.
+    // The shard is kept in the cursor's top 16 bits, which caps the shard
+    // count at kMaxShards.
+    static constexpr unsigned kScanShardShift = 48;
+    static constexpr size_t kMaxShards = size_t(1) << (64 - kScanShardShift);
+    uint64_t scan(uint64_t cursor, size_t count, KeyValueList& out) const;
+    
     // Persistence
     void save_snapshot() const;
     bool load_snapshot();
     
     // Metrics
-    const PerformanceMetrics& get_metrics() const { return metrics_; }
+    const PerformanceMetrics& get_metrics() const;
     void reset_metrics();
     
     // Info
     size_t size() const;
     bool empty() const;
+    size_t memory_usage() const;
+    size_t max_memory_bytes() const;
+    size_t shard_count() const { return shards_.size(); }
+    RecencyMode recency_mode() const { return shards_[0]->recency_mode(); }
+    EvictionPolicyType policy_type() const { return shards_[0]->policy_type(); }
 };
 
 } // namespace kvstore
@@ -2,163 +2,1831 @@
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <list>
+#include <unordered_map>
 
 namespace kvstore {
 
-LRUCache::LRUCache(size_t cap) : capacity(cap), current_size(0) {
-    if (capacity == 0) {
-        throw std::invalid_argument("Cache capacity must be greater than 0");
+FlatIndex::Table FlatIndex::make_table(size_t groups) {
+    // Nothing here touches the new memory: zeroed control bytes are all
+    // empty and slots are only read behind a full one, so a large table's
+    // pages are faulted in by later inserts instead of by the resizing put
+    Table table;
+    table.ctrl.reset(static_cast<int8_t*>(std::calloc(groups * kGroupWidth, sizeof(int8_t))));
+    if (!table.ctrl) {
+        throw std::bad_alloc();
+    }
+    table.slots.reset(new Slot[groups * kGroupWidth]);
+    table.group_mask = groups - 1;
+    return table;
+}
+
+void FlatIndex::clear() {
+    table_ = make_table(1);
+    old_ = Table();
+    migrated_ = 0;
+}
+
+void FlatIndex::place(Table& table, uint32_t h, uint32_t id) {
+    size_t group = (h >> 7) & table.group_mask;
+    for (size_t step = 1;; ++step) {
+        int8_t* ctrl = table.ctrl.get() + group * kGroupWidth;
+        uint32_t mask = match_empty_or_deleted(ctrl);
+        if (mask != 0) {
+            size_t i = group * kGroupWidth + __builtin_ctz(mask);
+            if (table.ctrl[i] == kDeleted) {
+                table.tombstones--;
+            }
+            table.ctrl[i] = fingerprint(h);
+            table.slots[i] = Slot{h, id};
+            table.size++;
+            return;
+        }
+        group = (group + step) & table.group_mask;
+    }
+}
+
+void FlatIndex::migrate(size_t groups) {
+    if (!old_.ctrl) {
+        return;
+    }
+    
+    size_t end = std::min(migrated_ + groups, old_.group_mask + 1);
+    for (; migrated_ < end; ++migrated_) {
+        int8_t* ctrl = old_.ctrl.get() + migrated_ * kGroupWidth;
+        for (uint32_t mask = match_full(ctrl); mask != 0; mask &= mask - 1) {
+            size_t i = migrated_ * kGroupWidth + __builtin_ctz(mask);
+            place(table_, old_.slots[i].hash, old_.slots[i].id);
+            // Tombstone rather than empty so probes for ids still in later
+            // groups keep going past this one
+            old_.ctrl[i] = kDeleted;
+            old_.size--;
+        }
+    }
+    if (migrated_ > old_.group_mask) {
+        old_ = Table();
+    }
+}
+
+void FlatIndex::insert(uint64_t hash, uint32_t id) {
+    migrate(kMigrateGroups);
+    
+    // Ids still in the old table will all land in the new one
+    if (size() + table_.tombstones + 1 > max_load(table_)) {
+        // A resize that has not finished yet completes first
+        migrate(SIZE_MAX);
+        
+        // Mostly tombstones: clean up at the same size; otherwise double
+        size_t groups = table_.group_mask + 1;
+        size_t new_groups = size() + 1 > max_load(table_) / 2 ? groups * 2 : groups;
+        old_ = std::move(table_);
+        table_ = make_table(new_groups);
+        migrated_ = 0;
+    }
+    place(table_, fold(hash), id);
+}
+
+bool FlatIndex::erase(uint64_t hash, uint32_t id) {
+    uint32_t h = fold(hash);
+    bool erased = erase_from(table_, h, id) || (old_.ctrl && erase_from(old_, h, id));
+    migrate(kMigrateGroups);
+    return erased;
+}
+
+bool FlatIndex::erase_from(Table& table, uint32_t h, uint32_t id) {
+    size_t group = (h >> 7) & table.group_mask;
+    for (size_t step = 1;; ++step) {
+        int8_t* ctrl = table.ctrl.get() + group * kGroupWidth;
+        for (uint32_t mask = match_byte(ctrl, fingerprint(h)); mask != 0; mask &= mask - 1) {
+            size_t i = group * kGroupWidth + __builtin_ctz(mask);
+            if (table.slots[i].id == id) {
+                // A group that still has an empty slot never ended a probe, so
+                // the slot can go back to empty; otherwise leave a tombstone.
+                if (match_byte(ctrl, kEmpty) != 0) {
+                    table.ctrl[i] = kEmpty;
+                } else {
+                    table.ctrl[i] = kDeleted;
+                    table.tombstones++;
+                }
+                table.size--;
+                return true;
+            }
+        }
+        if (match_byte(ctrl, kEmpty) != 0) {
+            return false;
+        }
+        group = (group + step) & table.group_mask;
+    }
+}
+
+uint32_t NodeArena::allocate() {
+    if (free_list_ != kNil) {
+        uint32_t id = free_list_;
+        free_list_ = (*this)[id].next;
+        return id;
     }
     
-    // Create dummy head and tail nodes
-    head = std::make_shared<Node>("", nullptr);
-    tail = std::make_shared<Node>("", nullptr);
-    head->next = tail;
-    tail->prev = head;
+    if (allocated_ % kNodesPerChunk == 0) {
+        chunks_.push_back(std::make_unique<CacheNode[]>(kNodesPerChunk));
+    }
+    return allocated_++;
+}
+
+void NodeArena::release(uint32_t id) {
+    CacheNode& n = (*this)[id];
+    n.prev = kNil;
+    n.next = free_list_;
+    free_list_ = id;
+}
+
+void NodeArena::clear() {
+    chunks_.clear();
+    allocated_ = 0;
+    free_list_ = kNil;
+}
+
+char* SlabAllocator::allocate(size_t size) {
+    if (size == 0) {
+        return nullptr;
+    }
+    requested_bytes_ += size;
+    if (size > kMaxSlabSize) {
+        char* p = new char[size];
+        large_blocks_.emplace(p, size);
+        reserved_bytes_ += size;
+        return p;
+    }
+    
+    size_t index = class_of(size);
+    SizeClass& size_class = classes_[index];
+    if (size_class.free_list != nullptr) {
+        char* p = size_class.free_list;
+        std::memcpy(&size_class.free_list, p, sizeof(char*));
+        return p;
+    }
+    
+    size_t slot_size = kClassSizes[index];
+    if (size_class.next == size_class.end) {
+        // Left uninitialized so a page is only faulted in as slots are used
+        pages_.emplace_back(new char[kPageSize]);
+        reserved_bytes_ += kPageSize;
+        size_class.next = pages_.back().get();
+        size_class.end = size_class.next + kPageSize / slot_size * slot_size;
+    }
+    char* p = size_class.next;
+    size_class.next += slot_size;
+    return p;
+}
+
+void SlabAllocator::deallocate(char* p, size_t size) {
+    if (p == nullptr) {
+        return;
+    }
+    requested_bytes_ -= size;
+    if (size > kMaxSlabSize) {
+        large_blocks_.erase(p);
+        reserved_bytes_ -= size;
+        delete[] p;
+        return;
+    }
+    
+    SizeClass& size_class = classes_[class_of(size)];
+    std::memcpy(p, &size_class.free_list, sizeof(char*));
+    size_class.free_list = p;
+}
+
+void SlabAllocator::clear() {
+    for (const auto& block : large_blocks_) {
+        delete[] block.first;
+    }
+    large_blocks_.clear();
+    pages_.clear();
+    std::fill(std::begin(classes_), std::end(classes_), SizeClass());
+    requested_bytes_ = 0;
+    reserved_bytes_ = 0;
+}
+
+CoarseClock::CoarseClock() : epoch_(std::chrono::steady_clock::now()) {
+    thread_ = std::thread([this] {
+        constexpr uint32_t kTicksPerTask = kTaskInterval / kTickInterval;
+        uint32_t last_task_tick = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_cv_.wait_for(lock, kTickInterval, [this] { return stopping_; })) {
+            // Derived from elapsed time, so late wakeups do not make it drift
+            auto elapsed = std::chrono::steady_clock::now() - epoch_;
+            uint32_t now = static_cast<uint32_t>(elapsed / kTickInterval);
+            ticks_.store(now, std::memory_order_relaxed);
+            
+            if (now - last_task_tick >= kTicksPerTask) {
+                last_task_tick = now;
+                // Tasks run without the stop lock so the destructor is not held up
+                lock.unlock();
+                {
+                    std::lock_guard<std::mutex> tasks_lock(tasks_mutex_);
+                    for (auto& task : tasks_) {
+                        task.second();
+                    }
+                }
+                lock.lock();
+            }
+        }
+    });
+}
+
+uint64_t CoarseClock::add_task(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    uint64_t id = next_task_id_++;
+    tasks_.emplace_back(id, std::move(task));
+    return id;
+}
+
+void CoarseClock::remove_task(uint64_t id) {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    tasks_.erase(std::remove_if(tasks_.begin(), tasks_.end(), [id](const auto& task) { return task.first == id; }),
+                 tasks_.end());
+}
+
+CoarseClock::~CoarseClock() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stop_cv_.notify_one();
+    thread_.join();
 }
 
-void LRUCache::move_to_front(NodePtr node) {
-    // Remove from current position
-    if (node->prev) node->prev->next = node->next;
-    if (node->next) node->next->prev = node->prev;
+void SlabAllocator::swap(SlabAllocator& other) noexcept {
+    std::swap(classes_, other.classes_);
+    pages_.swap(other.pages_);
+    large_blocks_.swap(other.large_blocks_);
+    std::swap(requested_bytes_, other.requested_bytes_);
+    std::swap(reserved_bytes_, other.reserved_bytes_);
+}
+
+Reclaimer::Reclaimer() : thread_([this] { run(); }) {}
+
+Reclaimer::~Reclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void Reclaimer::push(std::unique_ptr<Garbage> garbage, size_t entries) {
+    backlog_ += entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(Item{std::move(garbage), entries});
+    }
+    cv_.notify_one();
+}
+
+void Reclaimer::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        Item item = std::move(queue_.front());
+        queue_.pop_front();
+        
+        // Destroy outside the queue lock so producers never wait on a free
+        lock.unlock();
+        item.garbage.reset();
+        backlog_ -= item.entries;
+        lock.lock();
+    }
+}
+
+TimingWheel::TimingWheel(NodeArena& nodes) : nodes_(&nodes), epoch_(Clock::now()) {
+    std::fill(std::begin(heads_), std::end(heads_), NodeArena::kNil);
+}
+
+uint64_t TimingWheel::deadline_tick(uint32_t id) const {
+    // Round up so a timer never fires before its entry has expired
+    auto delta = std::chrono::duration_cast<std::chrono::nanoseconds>((*nodes_)[id].entry.expires_at - epoch_);
+    return delta.count() <= 0 ? 0 : (static_cast<uint64_t>(delta.count()) + 999999) / 1000000;
+}
+
+void TimingWheel::file(uint32_t id, uint64_t deadline) {
+    // Deadlines past the top level's span wait at its far end and re-file
+    // when they cascade
+    constexpr uint64_t kHorizon = uint64_t(1) << (kSlotBits * kLevels);
+    if (deadline - now_ >= kHorizon) {
+        deadline = now_ + kHorizon - 1;
+    }
+    
+    size_t level = 0;
+    while ((deadline - now_) >> (kSlotBits * (level + 1)) != 0) {
+        level++;
+    }
+    size_t slot = level * kSlots + ((deadline >> (kSlotBits * level)) & (kSlots - 1));
     
-    // Insert after head
-    node->next = head->next;
-    node->prev = head;
-    head->next->prev = node;
-    head->next = node;
+    CacheNode& n = (*nodes_)[id];
+    n.timer_slot = static_cast<uint16_t>(slot);
+    n.timer_prev = NodeArena::kNil;
+    n.timer_next = heads_[slot];
+    if (heads_[slot] != NodeArena::kNil) {
+        (*nodes_)[heads_[slot]].timer_prev = id;
+    }
+    heads_[slot] = id;
+    level_size_[level]++;
+    size_.store(size_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void TimingWheel::unlink(uint32_t id) {
+    CacheNode& n = (*nodes_)[id];
+    if (n.timer_prev != NodeArena::kNil) {
+        (*nodes_)[n.timer_prev].timer_next = n.timer_next;
+    } else {
+        heads_[n.timer_slot] = n.timer_next;
+    }
+    if (n.timer_next != NodeArena::kNil) {
+        (*nodes_)[n.timer_next].timer_prev = n.timer_prev;
+    }
+    level_size_[n.timer_slot / kSlots]--;
+    size_.store(size_.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    n.timer_slot = CacheNode::kNoTimer;
 }
 
-void LRUCache::remove_node(NodePtr node) {
-    if (node->prev) node->prev->next = node->next;
-    if (node->next) node->next->prev = node->prev;
+void TimingWheel::schedule(uint32_t id) {
+    // The current tick's slot has already fired
+    file(id, std::max(deadline_tick(id), now_ + 1));
 }
 
-LRUCache::NodePtr LRUCache::remove_tail() {
-    NodePtr last = tail->prev;
-    if (last != head) {
-        remove_node(last);
-        return last;
+void TimingWheel::cancel(uint32_t id) {
+    if ((*nodes_)[id].timer_slot != CacheNode::kNoTimer) {
+        unlink(id);
     }
-    return nullptr;
 }
 
-bool LRUCache::get(const std::string& key, std::string& value) {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+void TimingWheel::advance(Clock::time_point now, std::vector<uint32_t>& due) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - epoch_).count();
+    uint64_t target = elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0;
     
-    auto it = cache_map.find(key);
-    if (it == cache_map.end()) {
+    while (now_ < target) {
+        // With levels below `level` empty, nothing happens until the next
+        // boundary of a level-`level` slot
+        size_t level = 0;
+        while (level < kLevels && level_size_[level] == 0) {
+            level++;
+        }
+        if (level == kLevels) {
+            now_ = target;
+            break;
+        }
+        if (level > 0) {
+            uint64_t next = (now_ | ((uint64_t(1) << (kSlotBits * level)) - 1)) + 1;
+            if (next > target) {
+                now_ = target;
+                break;
+            }
+            now_ = next - 1;
+        }
+        
+        ++now_;
+        for (size_t l = 1; l < kLevels && (now_ & ((uint64_t(1) << (kSlotBits * l)) - 1)) == 0; ++l) {
+            uint32_t& head = heads_[l * kSlots + ((now_ >> (kSlotBits * l)) & (kSlots - 1))];
+            while (head != NodeArena::kNil) {
+                uint32_t id = head;
+                unlink(id);
+                file(id, std::max(deadline_tick(id), now_));
+            }
+        }
+        
+        uint32_t& head = heads_[now_ & (kSlots - 1)];
+        while (head != NodeArena::kNil) {
+            uint32_t id = head;
+            unlink(id);
+            due.push_back(id);
+        }
+    }
+}
+
+void TimingWheel::clear() {
+    std::fill(std::begin(heads_), std::end(heads_), NodeArena::kNil);
+    std::fill(std::begin(level_size_), std::end(level_size_), 0);
+    size_.store(0, std::memory_order_relaxed);
+}
+
+const char* eviction_policy_name(EvictionPolicyType type) {
+    switch (type) {
+        case EvictionPolicyType::LRU: return "lru";
+        case EvictionPolicyType::WTinyLFU: return "wtinylfu";
+        case EvictionPolicyType::SLRU: return "slru";
+        case EvictionPolicyType::ARC: return "arc";
+        case EvictionPolicyType::SIEVE: return "sieve";
+    }
+    return "unknown";
+}
+
+bool parse_eviction_policy(std::string_view name, EvictionPolicyType& type) {
+    for (auto candidate : {EvictionPolicyType::LRU, EvictionPolicyType::WTinyLFU,
+                           EvictionPolicyType::SLRU, EvictionPolicyType::ARC,
+                           EvictionPolicyType::SIEVE}) {
+        if (name == eviction_policy_name(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Instrumented shared locks this thread holds and when it took each,
+// innermost last. Entries are matched by mutex on unlock, so releasing
+// locks out of order still charges each lock its own hold time.
+using SharedHoldStarts = std::vector<std::pair<const void*, std::chrono::steady_clock::time_point>>;
+
+SharedHoldStarts& shared_hold_starts() {
+    thread_local SharedHoldStarts starts;
+    return starts;
+}
+
+// Removes and returns when this thread took the shared lock on mutex
+std::chrono::steady_clock::time_point take_shared_hold_start(const void* mutex) {
+    auto& starts = shared_hold_starts();
+    auto it = std::find_if(starts.rbegin(), starts.rend(),
+                           [mutex](const auto& held) { return held.first == mutex; });
+    auto start = it->second;
+    starts.erase(std::next(it).base());
+    return start;
+}
+
+uint64_t elapsed_ns(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+} // namespace
+
+void InstrumentedSharedMutex::lock() {
+    if (!instrumented_) {
+        mutex_.lock();
+        return;
+    }
+    if (!mutex_.try_lock()) {
+        auto start = Clock::now();
+        mutex_.lock();
+        exclusive_since_ = Clock::now();
+        stats_.exclusive.contended.fetch_add(1, std::memory_order_relaxed);
+        stats_.exclusive.wait_ns.fetch_add(elapsed_ns(start, exclusive_since_), std::memory_order_relaxed);
+    } else {
+        exclusive_since_ = Clock::now();
+    }
+    stats_.exclusive.acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedSharedMutex::try_lock() {
+    if (!mutex_.try_lock()) {
         return false;
     }
+    if (instrumented_) {
+        exclusive_since_ = Clock::now();
+        stats_.exclusive.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void InstrumentedSharedMutex::unlock() {
+    if (instrumented_) {
+        stats_.exclusive.hold_ns.fetch_add(elapsed_ns(exclusive_since_, Clock::now()), std::memory_order_relaxed);
+    }
+    mutex_.unlock();
+}
+
+void InstrumentedSharedMutex::lock_shared() {
+    if (!instrumented_) {
+        mutex_.lock_shared();
+        return;
+    }
+    if (!mutex_.try_lock_shared()) {
+        auto start = Clock::now();
+        mutex_.lock_shared();
+        auto acquired = Clock::now();
+        shared_hold_starts().emplace_back(this, acquired);
+        stats_.shared.contended.fetch_add(1, std::memory_order_relaxed);
+        stats_.shared.wait_ns.fetch_add(elapsed_ns(start, acquired), std::memory_order_relaxed);
+    } else {
+        shared_hold_starts().emplace_back(this, Clock::now());
+    }
+    stats_.shared.acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedSharedMutex::try_lock_shared() {
+    if (!mutex_.try_lock_shared()) {
+        return false;
+    }
+    if (instrumented_) {
+        shared_hold_starts().emplace_back(this, Clock::now());
+        stats_.shared.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void InstrumentedSharedMutex::unlock_shared() {
+    if (instrumented_) {
+        auto start = take_shared_hold_start(this);
+        stats_.shared.hold_ns.fetch_add(elapsed_ns(start, Clock::now()), std::memory_order_relaxed);
+    }
+    mutex_.unlock_shared();
+}
+
+const char* eviction_reason_name(EvictionReason reason) {
+    switch (reason) {
+        case EvictionReason::Capacity: return "capacity";
+        case EvictionReason::Memory: return "memory";
+        case EvictionReason::Expired: return "expired";
+        case EvictionReason::Explicit: return "explicit";
+    }
+    return "unknown";
+}
+
+namespace {
+
+class LruPolicy : public EvictionPolicy {
+public:
+    LruPolicy(NodeArena& nodes, RecencyMode recency, const CoarseClock& ticks)
+        : nodes_(&nodes), list_(nodes), ticks_(ticks), clock_(recency == RecencyMode::Clock) {}
+    
+    bool concurrent_hits() const override { return clock_; }
+    void on_insert(uint32_t id) override { list_.push_front(id); }
+    void on_access(uint32_t id) override { list_.move_to_front(id); }
+    void on_remove(uint32_t id) override { list_.remove(id); }
+    void clear() override { list_.clear(); }
+    void rebind(NodeArena& nodes) override {
+        nodes_ = &nodes;
+        list_.rebind(nodes);
+    }
     
-    // Update access time and count
-    it->second->entry->last_accessed = std::chrono::steady_clock::now();
-    it->second->entry->access_count++;
+    void on_shared_access(uint32_t id) override { (*nodes_)[id].entry.mark_referenced(); }
     
-    // Move to front (most recently used)
-    lock.unlock();
-    std::unique_lock<std::shared_mutex> write_lock(mutex_);
-    move_to_front(it->second);
+    uint32_t evict() override {
+        if (clock_) {
+            // Second chance: referenced entries are cleared and moved to the front
+            // instead of being evicted. Each pass clears a bit, so this terminates.
+            // The bit stands for hits since the last pass, so only the recency
+            // tick moves; the access count is left alone.
+            uint32_t last = list_.back();
+            while (last != NodeArena::kNil && (*nodes_)[last].entry.referenced()) {
+                CacheEntry& entry = (*nodes_)[last].entry;
+                entry.clear_referenced();
+                entry.set_last_access_tick(ticks_.ticks());
+                list_.move_to_front(last);
+                last = list_.back();
+            }
+        }
+        
+        uint32_t victim = list_.back();
+        if (victim != NodeArena::kNil) {
+            list_.remove(victim);
+        }
+        return victim;
+    }
+    
+    void for_each(const std::function<void(uint32_t)>& fn) const override { list_.for_each(fn); }
+    
+private:
+    NodeArena* nodes_;
+    NodeList list_;
+    const CoarseClock& ticks_;
+    bool clock_;
+};
+
+// Probation and protected segments, used on their own as SLRU and as the
+// main space of W-TinyLFU. Entries start on probation and are promoted once
+// their access_count reaches kPromoteAccesses, i.e. on the first hit after
+// insertion. Protected overflow is demoted to the front of probation with
+// its count reset, so it has to be hit again to get back in.
+class SegmentedLru {
+public:
+    static constexpr uint8_t kProbation = 1;
+    static constexpr uint8_t kProtected = 2;
+    static constexpr size_t kPromoteAccesses = 2;
+    
+    SegmentedLru(NodeArena& nodes, size_t protected_max)
+        : nodes_(&nodes), probation_(nodes), protected_(nodes), protected_max_(protected_max) {}
+    
+    const NodeList& probation() const { return probation_; }
+    
+    void insert(uint32_t id) {
+        (*nodes_)[id].segment = kProbation;
+        probation_.push_front(id);
+    }
+    
+    void access(uint32_t id) {
+        CacheNode& n = (*nodes_)[id];
+        if (n.segment == kProtected) {
+            protected_.move_to_front(id);
+        } else if (n.entry.access_count() < kPromoteAccesses) {
+            probation_.move_to_front(id);
+        } else {
+            probation_.remove(id);
+            promote(id);
+        }
+    }
+    
+    void remove(uint32_t id) {
+        ((*nodes_)[id].segment == kProtected ? protected_ : probation_).remove(id);
+    }
+    
+    // Unlinks probation's LRU entry, or protected's when probation is empty.
+    uint32_t evict() {
+        NodeList& list = !probation_.empty() ? probation_ : protected_;
+        uint32_t victim = list.back();
+        if (victim != NodeArena::kNil) {
+            list.remove(victim);
+        }
+        return victim;
+    }
+    
+    void clear() {
+        probation_.clear();
+        protected_.clear();
+    }
+    
+    void rebind(NodeArena& nodes) {
+        nodes_ = &nodes;
+        probation_.rebind(nodes);
+        protected_.rebind(nodes);
+    }
+    
+    void for_each(const std::function<void(uint32_t)>& fn) const {
+        protected_.for_each(fn);
+        probation_.for_each(fn);
+    }
+    
+private:
+    NodeArena* nodes_;
+    NodeList probation_;
+    NodeList protected_;
+    size_t protected_max_;
+    
+    void promote(uint32_t id) {
+        (*nodes_)[id].segment = kProtected;
+        protected_.push_front(id);
+        if (protected_.size() > protected_max_) {
+            uint32_t demoted = protected_.back();
+            protected_.remove(demoted);
+            (*nodes_)[demoted].entry.set_access_count(1);
+            insert(demoted);
+        }
+    }
+};
+
+// Segmented LRU: an entry must be hit once more before it is protected, so
+// a scan only churns the probation segment (20% of the capacity).
+class SlruPolicy : public EvictionPolicy {
+public:
+    SlruPolicy(NodeArena& nodes, size_t expected_entries)
+        : segments_(nodes, std::max<size_t>(1, expected_entries * 8 / 10)) {}
+    
+    void on_insert(uint32_t id) override { segments_.insert(id); }
+    void on_access(uint32_t id) override { segments_.access(id); }
+    void on_remove(uint32_t id) override { segments_.remove(id); }
+    uint32_t evict() override { return segments_.evict(); }
+    void clear() override { segments_.clear(); }
+    void rebind(NodeArena& nodes) override { segments_.rebind(nodes); }
+    void for_each(const std::function<void(uint32_t)>& fn) const override { segments_.for_each(fn); }
+    
+private:
+    SegmentedLru segments_;
+};
+
+// Count-min sketch of 4-bit saturating counters in four rows. Counters are
+// halved after sample_size increments so old popularity fades.
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t expected_entries) {
+        width_ = 64;
+        while (width_ < expected_entries) {
+            width_ <<= 1;
+        }
+        counters_.assign(width_ * kRows, 0);
+        sample_size_ = 10 * std::max<size_t>(expected_entries, 64);
+    }
+    
+    uint32_t frequency(uint64_t hash) const {
+        uint32_t freq = kMaxCount;
+        for (size_t row = 0; row < kRows; ++row) {
+            freq = std::min<uint32_t>(freq, counters_[slot(hash, row)]);
+        }
+        return freq;
+    }
+    
+    void increment(uint64_t hash) {
+        bool added = false;
+        for (size_t row = 0; row < kRows; ++row) {
+            uint8_t& counter = counters_[slot(hash, row)];
+            if (counter < kMaxCount) {
+                counter++;
+                added = true;
+            }
+        }
+        if (added && ++additions_ >= sample_size_) {
+            for (uint8_t& counter : counters_) {
+                counter >>= 1;
+            }
+            additions_ /= 2;
+        }
+    }
+    
+    void clear() {
+        std::fill(counters_.begin(), counters_.end(), 0);
+        additions_ = 0;
+    }
+    
+private:
+    static constexpr size_t kRows = 4;
+    static constexpr uint8_t kMaxCount = 15;
+    
+    std::vector<uint8_t> counters_;
+    size_t width_;
+    size_t sample_size_;
+    size_t additions_ = 0;
+    
+    size_t slot(uint64_t hash, size_t row) const {
+        static constexpr uint64_t kSeeds[kRows] = {
+            0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull, 0x9ae16a3b2f90404full, 0xcbf29ce484222325ull};
+        uint64_t h = (hash + kSeeds[row]) * 0x9E3779B97F4A7C15ull;
+        return row * width_ + ((h >> 32) & (width_ - 1));
+    }
+};
+
+// W-TinyLFU: new entries enter a small LRU window (1% of capacity). Entries
+// pushed out of the window join the probation segment of a segmented LRU
+// main space as the admission candidate; when the cache must evict, the
+// candidate only displaces probation's LRU victim if the sketch has seen it
+// more often. The protected segment takes 80% of the main space.
+class WTinyLfuPolicy : public EvictionPolicy {
+public:
+    WTinyLfuPolicy(NodeArena& nodes, size_t expected_entries)
+        : nodes_(&nodes), window_(nodes),
+          main_(nodes, std::max<size_t>(1, main_size(expected_entries) * 8 / 10)),
+          sketch_(expected_entries),
+          window_max_(std::max<size_t>(1, expected_entries / 100)) {}
+    
+    void on_insert(uint32_t id) override {
+        sketch_.increment((*nodes_)[id].hash);
+        (*nodes_)[id].segment = kWindow;
+        window_.push_front(id);
+        
+        if (window_.size() > window_max_) {
+            uint32_t spilled = window_.back();
+            window_.remove(spilled);
+            main_.insert(spilled);
+            candidate_ = spilled;
+        }
+    }
+    
+    void on_access(uint32_t id) override {
+        sketch_.increment((*nodes_)[id].hash);
+        if ((*nodes_)[id].segment == kWindow) {
+            window_.move_to_front(id);
+            return;
+        }
+        if (id == candidate_) {
+            candidate_ = NodeArena::kNil;
+        }
+        main_.access(id);
+    }
+    
+    void on_remove(uint32_t id) override {
+        if ((*nodes_)[id].segment == kWindow) {
+            window_.remove(id);
+        } else {
+            main_.remove(id);
+        }
+        if (id == candidate_) {
+            candidate_ = NodeArena::kNil;
+        }
+    }
+    
+    uint32_t evict() override {
+        uint32_t victim = main_.probation().back();
+        if (victim == NodeArena::kNil) {
+            // Nothing on probation yet: fall back to protected, then the window
+            victim = main_.evict();
+            if (victim == NodeArena::kNil && (victim = window_.back()) != NodeArena::kNil) {
+                window_.remove(victim);
+            }
+            return victim;
+        }
+        
+        uint32_t chosen = victim;
+        if (candidate_ != NodeArena::kNil && candidate_ != victim &&
+            sketch_.frequency((*nodes_)[candidate_].hash) <= sketch_.frequency((*nodes_)[victim].hash)) {
+            // The newcomer is not more popular than the victim: reject it
+            chosen = candidate_;
+        }
+        
+        main_.remove(chosen);
+        if (chosen == candidate_) {
+            candidate_ = NodeArena::kNil;
+        }
+        return chosen;
+    }
+    
+    void clear() override {
+        window_.clear();
+        main_.clear();
+        candidate_ = NodeArena::kNil;
+        sketch_.clear();
+    }
+    
+    void rebind(NodeArena& nodes) override {
+        nodes_ = &nodes;
+        window_.rebind(nodes);
+        main_.rebind(nodes);
+    }
+    
+    void for_each(const std::function<void(uint32_t)>& fn) const override {
+        main_.for_each(fn);
+        window_.for_each(fn);
+    }
+    
+private:
+    static constexpr uint8_t kWindow = 0;
+    
+    NodeArena* nodes_;
+    NodeList window_;
+    SegmentedLru main_;
+    FrequencySketch sketch_;
+    size_t window_max_;
+    uint32_t candidate_ = NodeArena::kNil;
+    
+    static size_t main_size(size_t expected_entries) {
+        size_t window = std::max<size_t>(1, expected_entries / 100);
+        return expected_entries > window ? expected_entries - window : 1;
+    }
+};
+
+// Hashes of recently evicted entries in LRU order; ARC's ghost lists.
+class GhostList {
+public:
+    size_t size() const { return order_.size(); }
+    
+    void push_front(uint64_t hash) {
+        erase(hash);
+        order_.push_front(hash);
+        index_[hash] = order_.begin();
+    }
+    
+    bool erase(uint64_t hash) {
+        auto it = index_.find(hash);
+        if (it == index_.end()) {
+            return false;
+        }
+        order_.erase(it->second);
+        index_.erase(it);
+        return true;
+    }
+    
+    void pop_back() {
+        index_.erase(order_.back());
+        order_.pop_back();
+    }
+    
+    void clear() {
+        order_.clear();
+        index_.clear();
+    }
+    
+private:
+    std::list<uint64_t> order_;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> index_;
+};
+
+// Adaptive Replacement Cache. T1 holds entries seen once recently and T2
+// entries hit at least once since insertion; the ghost lists B1 and B2 keep
+// the hashes of entries evicted from each. Re-inserting a key found in B1
+// grows the target size of T1, one found in B2 shrinks it, so the split
+// between recency and frequency follows the workload without tuning.
+// The cache evicts before it inserts, so a ghost hit adjusts the target
+// from the following eviction on.
+class ArcPolicy : public EvictionPolicy {
+public:
+    ArcPolicy(NodeArena& nodes, size_t expected_entries)
+        : nodes_(&nodes), t1_(nodes), t2_(nodes), capacity_(std::max<size_t>(1, expected_entries)) {}
+    
+    void on_insert(uint32_t id) override {
+        uint64_t hash = (*nodes_)[id].hash;
+        size_t b1 = b1_.size();
+        size_t b2 = b2_.size();
+        
+        if (b1_.erase(hash)) {
+            target_t1_ = std::min(capacity_, target_t1_ + std::max<size_t>(b2 / b1, 1));
+            link(id, kT2);
+        } else if (b2_.erase(hash)) {
+            target_t1_ -= std::min(target_t1_, std::max<size_t>(b1 / b2, 1));
+            link(id, kT2);
+        } else {
+            link(id, kT1);
+            trim_ghosts();
+        }
+    }
+    
+    void on_access(uint32_t id) override {
+        if ((*nodes_)[id].segment == kT2) {
+            t2_.move_to_front(id);
+        } else {
+            t1_.remove(id);
+            link(id, kT2);
+        }
+    }
+    
+    void on_remove(uint32_t id) override { list_for((*nodes_)[id].segment).remove(id); }
+    
+    uint32_t evict() override {
+        bool from_t1 = !t1_.empty() && (t1_.size() > target_t1_ || t2_.empty());
+        NodeList& list = from_t1 ? t1_ : t2_;
+        uint32_t victim = list.back();
+        if (victim == NodeArena::kNil) {
+            return victim;
+        }
+        
+        list.remove(victim);
+        (from_t1 ? b1_ : b2_).push_front((*nodes_)[victim].hash);
+        trim_ghosts();
+        return victim;
+    }
+    
+    void clear() override {
+        t1_.clear();
+        t2_.clear();
+        b1_.clear();
+        b2_.clear();
+        target_t1_ = 0;
+    }
+    
+    void rebind(NodeArena& nodes) override {
+        nodes_ = &nodes;
+        t1_.rebind(nodes);
+        t2_.rebind(nodes);
+    }
+    
+    void for_each(const std::function<void(uint32_t)>& fn) const override {
+        t2_.for_each(fn);
+        t1_.for_each(fn);
+    }
+    
+private:
+    enum Segment : uint8_t { kT1, kT2 };
+    
+    NodeArena* nodes_;
+    NodeList t1_;
+    NodeList t2_;
+    GhostList b1_;
+    GhostList b2_;
+    size_t capacity_;
+    size_t target_t1_ = 0;
+    
+    NodeList& list_for(uint8_t segment) { return segment == kT2 ? t2_ : t1_; }
+    
+    void link(uint32_t id, Segment segment) {
+        (*nodes_)[id].segment = segment;
+        list_for(segment).push_front(id);
+    }
+    
+    // Keeps |T1| + |B1| <= c and the whole directory within 2c.
+    void trim_ghosts() {
+        while (b1_.size() != 0 && t1_.size() + b1_.size() > capacity_) {
+            b1_.pop_back();
+        }
+        while (t1_.size() + t2_.size() + b1_.size() + b2_.size() > 2 * capacity_) {
+            (b2_.size() != 0 ? b2_ : b1_).pop_back();
+        }
+    }
+};
+
+// SIEVE: entries stay in insertion order and a hit only sets the entry's
+// visited bit, under the shared lock. Eviction moves a hand from the oldest
+// entry toward the newest, clearing visited bits until it finds an unvisited
+// entry; the hand keeps its position between evictions and wraps around.
+class SievePolicy : public EvictionPolicy {
+public:
+    explicit SievePolicy(NodeArena& nodes) : nodes_(&nodes), list_(nodes) {}
+    
+    bool concurrent_hits() const override { return true; }
+    void on_insert(uint32_t id) override { list_.push_front(id); }
+    void on_access(uint32_t id) override { on_shared_access(id); }
+    
+    void on_shared_access(uint32_t id) override { (*nodes_)[id].entry.mark_referenced(); }
+    
+    void on_remove(uint32_t id) override {
+        if (id == hand_) {
+            hand_ = (*nodes_)[id].prev;
+        }
+        list_.remove(id);
+    }
+    
+    uint32_t evict() override {
+        if (list_.empty()) {
+            return NodeArena::kNil;
+        }
+        
+        // Each step clears a bit, so at most one full sweep before a victim
+        uint32_t hand = hand_ != NodeArena::kNil ? hand_ : list_.back();
+        while ((*nodes_)[hand].entry.referenced()) {
+            (*nodes_)[hand].entry.clear_referenced();
+            hand = (*nodes_)[hand].prev != NodeArena::kNil ? (*nodes_)[hand].prev : list_.back();
+        }
+        
+        hand_ = (*nodes_)[hand].prev;
+        list_.remove(hand);
+        return hand;
+    }
+    
+    void clear() override {
+        list_.clear();
+        hand_ = NodeArena::kNil;
+    }
+    
+    void rebind(NodeArena& nodes) override {
+        nodes_ = &nodes;
+        list_.rebind(nodes);
+    }
+    
+    void for_each(const std::function<void(uint32_t)>& fn) const override { list_.for_each(fn); }
+    
+private:
+    NodeArena* nodes_;
+    NodeList list_;
+    // Next entry to examine; kNil restarts from the oldest entry
+    uint32_t hand_ = NodeArena::kNil;
+};
+
+} // namespace
+
+std::unique_ptr<EvictionPolicy> make_eviction_policy(const CacheOptions& options, NodeArena& nodes) {
+    // Policies that size their structures need an entry estimate; under a
+    // pure memory budget assume ~256 bytes per entry.
+    size_t expected_entries = options.capacity != 0
+        ? options.capacity
+        : std::max<size_t>(options.max_memory_bytes / 256, 64);
+    
+    switch (options.policy) {
+        case EvictionPolicyType::WTinyLFU:
+            return std::make_unique<WTinyLfuPolicy>(nodes, expected_entries);
+        case EvictionPolicyType::SLRU:
+            return std::make_unique<SlruPolicy>(nodes, expected_entries);
+        case EvictionPolicyType::ARC:
+            return std::make_unique<ArcPolicy>(nodes, expected_entries);
+        case EvictionPolicyType::SIEVE:
+            return std::make_unique<SievePolicy>(nodes);
+        case EvictionPolicyType::LRU:
+        default:
+            return std::make_unique<LruPolicy>(nodes, options.recency, *options.clock);
+    }
+}
+
+LRUCache::LRUCache(size_t cap, RecencyMode recency)
+    : LRUCache(CacheOptions{cap, recency, 0, EvictionPolicyType::LRU, false, nullptr, nullptr, nullptr, false}) {}
+
+LRUCache::LRUCache(const CacheOptions& options)
+    : clock_(options.clock ? options.clock : std::make_shared<CoarseClock>()), reclaimer_(options.reclaimer),
+      wheel_(nodes_), on_evict_(options.on_evict), capacity(options.capacity), current_size(0),
+      max_memory_bytes_(options.max_memory_bytes), recency_(options.recency),
+      policy_type_(options.policy), mutex_(options.lock_stats) {
+    if (capacity == 0 && max_memory_bytes_ == 0) {
+        throw std::invalid_argument("Cache capacity must be greater than 0");
+    }
+    if (capacity >= kNil - 1) {
+        throw std::invalid_argument("Cache capacity exceeds 32-bit node index range");
+    }
+    
+    options_ = options;
+    options_.clock = clock_;
+    policy_ = make_eviction_policy(options_, nodes_);
+    if (options.ordered_index) {
+        ordered_ = std::make_unique<std::map<std::string_view, uint32_t>>();
+    }
+    expiry_task_ = clock_->add_task([this] { expire_in_background(); });
+}
+
+LRUCache::~LRUCache() {
+    clock_->remove_task(expiry_task_);
+}
+
+struct LRUCache::DetachedEntries {
+    FlatIndex index;
+    NodeArena nodes;
+    SlabAllocator slab;
+    std::unique_ptr<std::map<std::string_view, uint32_t>> ordered;
+    // Rebound to nodes above before the handoff, so destroying it on the
+    // reclaimer thread never touches the shard's live arena
+    std::unique_ptr<EvictionPolicy> policy;
+};
+
+Reclaimer& LRUCache::reclaimer_locked() {
+    if (!reclaimer_) {
+        reclaimer_ = std::make_shared<Reclaimer>();
+    }
+    return *reclaimer_;
+}
+
+void LRUCache::reset_entries() {
+    index_.clear();
+    if (ordered_) {
+        ordered_->clear();
+    }
+    wheel_.clear();
+    policy_->clear();
+    nodes_.clear();
+    slab_.clear();
+    current_size = 0;
+    used_bytes_ = 0;
+}
+
+uint32_t LRUCache::find_node(std::string_view key, uint64_t hash) const {
+    return index_.find(hash, [&](uint32_t id) { return nodes_[id].key() == key; });
+}
+
+std::string_view LRUCache::value_view(const CacheEntry& entry, char* digits) {
+    switch (entry.encoding) {
+    case ValueEncoding::Inline:
+        return std::string_view(entry.inline_value, entry.inline_size);
+    case ValueEncoding::Shared:
+        return *entry.value;
+    default: {
+        auto res = std::to_chars(digits, digits + 20, entry.integer);
+        return std::string_view(digits, res.ptr - digits);
+    }
+    }
+}
+
+ValuePtr LRUCache::value_of(const CacheEntry& entry) {
+    if (entry.encoding == ValueEncoding::Shared) {
+        return entry.value;
+    }
+    char digits[20];
+    return std::make_shared<const std::string>(value_view(entry, digits));
+}
+
+void LRUCache::release_value(CacheEntry& entry, ValuePtr& retired) {
+    used_bytes_ -= value_charge(entry);
+    if (entry.encoding == ValueEncoding::Inline) {
+        slab_.deallocate(entry.inline_value, entry.inline_size);
+        entry.inline_value = nullptr;
+        entry.inline_size = 0;
+    } else if (entry.encoding == ValueEncoding::Shared) {
+        if (!retired) {
+            retired = std::move(entry.value);
+        }
+        entry.value.reset();
+    }
+    entry.encoding = ValueEncoding::Integer;
+    entry.integer = 0;
+}
+
+void LRUCache::assign_value(CacheEntry& entry, std::string_view value, ValuePtr shared, ValuePtr& retired) {
+    release_value(entry, retired);
+    if (shared) {
+        entry.value = std::move(shared);
+        entry.encoding = ValueEncoding::Shared;
+    } else {
+        entry.inline_value = slab_.allocate(value.size());
+        std::copy(value.begin(), value.end(), entry.inline_value);
+        entry.inline_size = static_cast<uint32_t>(value.size());
+        entry.encoding = ValueEncoding::Inline;
+    }
+    used_bytes_ += value_charge(entry);
+}
+
+uint32_t LRUCache::insert_node(std::string_view key, uint64_t hash) {
+    uint32_t id = nodes_.allocate();
+    CacheNode& n = nodes_[id];
+    n.key_data = slab_.allocate(key.size());
+    std::copy(key.begin(), key.end(), n.key_data);
+    n.key_size = static_cast<uint32_t>(key.size());
+    n.hash = hash;
+    n.entry.encoding = ValueEncoding::Integer;
+    n.entry.version = ++last_version_;
+    n.entry.touch(clock_->ticks());
+    
+    index_.insert(hash, id);
+    policy_->on_insert(id);
+    used_bytes_ += node_charge(n.key_size);
+    if (ordered_) {
+        ordered_->emplace(n.key(), id);
+    }
+    current_size++;
+    return id;
+}
+
+void LRUCache::free_node(uint32_t id, ValuePtr& retired) {
+    CacheNode& n = nodes_[id];
+    index_.erase(n.hash, id);
+    release_value(n.entry, retired);
+    used_bytes_ -= node_charge(n.key_size);
+    if (ordered_) {
+        ordered_->erase(n.key());
+    }
+    current_size--;
     
-    value = it->second->entry->value;
+    wheel_.cancel(id);
+    
+    slab_.deallocate(n.key_data, n.key_size);
+    n.key_data = nullptr;
+    n.key_size = 0;
+    n.entry.expires_at = std::chrono::steady_clock::time_point::max();
+    n.entry.version = 0;
+    n.entry.meta.store(0, std::memory_order_relaxed);
+    n.segment = 0;
+    nodes_.release(id);
+}
+
+void LRUCache::evict_node(uint32_t id, EvictionReason reason, ValuePtr& retired) {
+    eviction_counts_[static_cast<size_t>(reason)].fetch_add(1, std::memory_order_relaxed);
+    if (on_evict_) {
+        const CacheNode& n = nodes_[id];
+        on_evict_(n.key(), value_of(n.entry), reason);
+    }
+    free_node(id, retired);
+}
+
+bool LRUCache::evict_one(EvictionReason reason, ValuePtr& retired) {
+    uint32_t victim = policy_->evict();
+    if (victim == kNil) {
+        return false;
+    }
+    evict_node(victim, reason, retired);
+    return true;
+}
+
+bool LRUCache::make_room(size_t incoming, uint32_t keep, ValuePtr& retired) {
+    // Room is made before the write, so the entry being written can never be
+    // the policy's victim; it may empty the cache for an oversized entry
+    while (max_memory_bytes_ != 0 && used_bytes_ + incoming > max_memory_bytes_) {
+        uint32_t victim = policy_->evict();
+        if (victim == kNil) {
+            break;
+        }
+        evict_node(victim, EvictionReason::Memory, retired);
+        if (victim == keep) {
+            return false;
+        }
+    }
     return true;
 }
 
-void LRUCache::put(const std::string& key, const std::string& value) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+void LRUCache::reset_eviction_counts() {
+    for (auto& count : eviction_counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint32_t LRUCache::find_live_node(std::string_view key, uint64_t hash, ValuePtr& retired) {
+    uint32_t id = find_node(key, hash);
+    if (id != FlatIndex::kNotFound && is_expired(nodes_[id].entry)) {
+        policy_->on_remove(id);
+        evict_node(id, EvictionReason::Expired, retired);
+        return FlatIndex::kNotFound;
+    }
+    return id;
+}
+
+void LRUCache::set_expiry(uint32_t id, std::chrono::steady_clock::time_point expires_at) {
+    wheel_.cancel(id);
+    nodes_[id].entry.expires_at = expires_at;
+    if (expires_at != std::chrono::steady_clock::time_point::max()) {
+        wheel_.schedule(id);
+    }
+}
+
+size_t LRUCache::expire_due(ValuePtr& retired) {
+    if (wheel_.size() == 0) {
+        return 0;
+    }
     
-    auto it = cache_map.find(key);
-    if (it != cache_map.end()) {
-        // Update existing entry
-        it->second->entry->value = value;
-        it->second->entry->last_accessed = std::chrono::steady_clock::now();
-        it->second->entry->access_count++;
-        move_to_front(it->second);
+    expired_.clear();
+    wheel_.advance(std::chrono::steady_clock::now(), expired_);
+    for (uint32_t id : expired_) {
+        policy_->on_remove(id);
+        evict_node(id, EvictionReason::Expired, retired);
+    }
+    return expired_.size();
+}
+
+void LRUCache::expire_in_background() {
+    // Shards without timers never take the exclusive lock for this
+    if (wheel_.size() == 0) {
         return;
     }
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    expire_due(retired);
+}
+
+bool LRUCache::get(std::string_view key, std::string& value) {
+    uint64_t version;
+    return get(key, value, version);
+}
+
+bool LRUCache::get(std::string_view key, std::string& value, uint64_t& version) {
+    // Short values are copied under the lock; long ones are pinned under it
+    // and copied after releasing it
+    BatchKey one{key, hash_key(key), 0};
+    ValuePtr pinned;
+    size_t hits = lookup_batch(&one, 1, [&](uint32_t, const CacheEntry& entry) {
+        if (entry.encoding == ValueEncoding::Shared) {
+            pinned = entry.value;
+        } else {
+            char digits[20];
+            value.assign(value_view(entry, digits));
+        }
+        version = entry.version;
+    });
+    if (pinned) {
+        value.assign(*pinned);
+    }
+    return hits != 0;
+}
+
+ValueRef LRUCache::get_ref(std::string_view key) {
+    BatchKey one{key, hash_key(key), 0};
+    ValueRef ref;
+    get_batch(&one, 1, &ref);
+    return ref;
+}
+
+size_t LRUCache::get_batch(const BatchKey* keys, size_t count, ValueRef* results, uint64_t* versions) {
+    return lookup_batch(keys, count, [&](uint32_t pos, const CacheEntry& entry) {
+        results[pos] = ValueRef(value_of(entry));
+        if (versions) {
+            versions[pos] = entry.version;
+        }
+    });
+}
+
+template <typename OnHit>
+size_t LRUCache::lookup_batch(const BatchKey* keys, size_t count, OnHit&& on_hit) {
+    size_t hits = 0;
+    
+    if (policy_->concurrent_hits()) {
+        std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+        
+        for (size_t i = 0; i < count; ++i) {
+            index_.prefetch(keys[i].hash);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t id = find_node(keys[i].key, keys[i].hash);
+            // Expired entries cannot be unlinked under the shared lock; the
+            // timing wheel reclaims them on the next write
+            if (id == FlatIndex::kNotFound || is_expired(nodes_[id].entry)) {
+                continue;
+            }
+            
+            policy_->on_shared_access(id);
+            on_hit(keys[i].pos, nodes_[id].entry);
+            hits++;
+        }
+        return hits;
+    }
     
-    // Add new entry
-    auto entry = std::make_shared<CacheEntry>(value);
-    auto node = std::make_shared<Node>(key, entry);
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
     
-    if (current_size >= capacity) {
-        // Evict least recently used
-        NodePtr tail_node = remove_tail();
-        if (tail_node) {
-            cache_map.erase(tail_node->key);
-            current_size--;
+    for (size_t i = 0; i < count; ++i) {
+        index_.prefetch(keys[i].hash);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        // A second expired key in the batch is released under the lock
+        uint32_t id = find_live_node(keys[i].key, keys[i].hash, retired);
+        if (id == FlatIndex::kNotFound) {
+            continue;
+        }
+        
+        // Update access time and count
+        CacheEntry& entry = nodes_[id].entry;
+        entry.touch(clock_->ticks());
+        
+        policy_->on_access(id);
+        on_hit(keys[i].pos, entry);
+        hits++;
+    }
+    return hits;
+}
+
+// Long values are built before the lock is taken; a replaced or evicted value
+// is released after the lock is dropped (retired outlives the guard).
+void LRUCache::put(std::string_view key, std::string_view value) {
+    put_until(key, value, share_if_long(value), std::chrono::steady_clock::time_point::max());
+}
+
+void LRUCache::put(std::string_view key, ValuePtr value) {
+    // Short values are still copied inline; the caller's buffer is released
+    // after unlocking
+    std::string_view bytes = *value;
+    if (bytes.size() <= CacheEntry::kInlineValueMax) {
+        put_until(key, bytes, nullptr, std::chrono::steady_clock::time_point::max());
+    } else {
+        put_until(key, bytes, std::move(value), std::chrono::steady_clock::time_point::max());
+    }
+}
+
+namespace {
+
+// now + ttl, saturating to time_point::max() (no expiry) for a ttl the clock
+// cannot represent instead of overflowing into the past
+std::chrono::steady_clock::time_point deadline_after(std::chrono::milliseconds ttl) {
+    auto now = std::chrono::steady_clock::now();
+    auto headroom = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::time_point::max() - now);
+    if (ttl >= headroom) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+    return now + ttl;
+}
+
+} // namespace
+
+void LRUCache::put(std::string_view key, std::string_view value, std::chrono::milliseconds ttl) {
+    if (ttl.count() <= 0) {
+        throw std::invalid_argument("TTL must be positive");
+    }
+    put_until(key, value, share_if_long(value), deadline_after(ttl));
+}
+
+void LRUCache::put_until(std::string_view key, std::string_view value, ValuePtr shared,
+                         std::chrono::steady_clock::time_point expires_at) {
+    uint64_t hash = hash_key(key);
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired);
+    put_locked(key, hash, value, std::move(shared), expires_at, retired);
+}
+
+bool LRUCache::put_locked(std::string_view key, uint64_t hash, std::string_view value, ValuePtr shared,
+                          std::chrono::steady_clock::time_point expires_at, ValuePtr& retired) {
+    uint32_t id = find_live_node(key, hash, retired);
+    size_t charge = value_charge(value.size(), shared ? ValueEncoding::Shared : ValueEncoding::Inline);
+    if (id != FlatIndex::kNotFound) {
+        // Update existing entry. If making room for a larger value evicts the
+        // entry itself, its old value is gone and the key is inserted afresh.
+        CacheEntry& entry = nodes_[id].entry;
+        policy_->on_access(id);
+        size_t current = value_charge(entry);
+        if (charge <= current || make_room(charge - current, id, retired)) {
+            assign_value(entry, value, std::move(shared), retired);
+            entry.version = ++last_version_;
+            entry.touch(clock_->ticks());
+            set_expiry(id, expires_at);
+            return false;
         }
     }
     
-    // Insert new node at front
-    node->next = head->next;
-    node->prev = head;
-    head->next->prev = node;
-    head->next = node;
+    if (capacity != 0 && current_size >= capacity) {
+        evict_one(EvictionReason::Capacity, retired);
+    }
+    make_room(node_charge(key.size()) + charge, kNil, retired);
     
-    cache_map[key] = node;
-    current_size++;
+    id = insert_node(key, hash);
+    assign_value(nodes_[id].entry, value, std::move(shared), retired);
+    set_expiry(id, expires_at);
+    return true;
 }
 
-bool LRUCache::remove(const std::string& key) {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+void LRUCache::put_batch(const BatchKey* keys, size_t count, const std::string_view* values) {
+    std::vector<ValuePtr> new_values;
+    new_values.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        new_values.push_back(share_if_long(values[keys[i].pos]));
+    }
+    // One retired slot per key, plus one for expiry, so replaced and evicted
+    // values are all released after the lock is dropped
+    std::vector<ValuePtr> retired(count + 1);
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired[count]);
+    for (size_t i = 0; i < count; ++i) {
+        index_.prefetch(keys[i].hash);
+    }
     
-    auto it = cache_map.find(key);
-    if (it == cache_map.end()) {
+    for (size_t i = 0; i < count; ++i) {
+        put_locked(keys[i].key, keys[i].hash, values[keys[i].pos], std::move(new_values[i]),
+                   std::chrono::steady_clock::time_point::max(), retired[i]);
+    }
+}
+
+bool LRUCache::remove(std::string_view key) {
+    uint64_t hash = hash_key(key);
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired);
+    uint32_t id = find_live_node(key, hash, retired);
+    if (id == FlatIndex::kNotFound) {
         return false;
     }
     
-    remove_node(it->second);
-    cache_map.erase(it);
-    current_size--;
+    policy_->on_remove(id);
+    evict_node(id, EvictionReason::Explicit, retired);
+    return true;
+}
+
+bool LRUCache::expire(std::string_view key, std::chrono::milliseconds ttl) {
+    uint64_t hash = hash_key(key);
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired);
+    uint32_t id = find_live_node(key, hash, retired);
+    if (id == FlatIndex::kNotFound) {
+        return false;
+    }
+    
+    if (ttl.count() <= 0) {
+        policy_->on_remove(id);
+        evict_node(id, EvictionReason::Explicit, retired);
+    } else {
+        set_expiry(id, deadline_after(ttl));
+    }
     return true;
 }
 
+bool LRUCache::compare_and_set(std::string_view key, uint64_t expected_version, std::string_view value) {
+    uint64_t hash = hash_key(key);
+    ValuePtr new_value = share_if_long(value);
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired);
+    uint32_t id = find_live_node(key, hash, retired);
+    uint64_t version = id != FlatIndex::kNotFound ? nodes_[id].entry.version : 0;
+    if (version != expected_version) {
+        return false;
+    }
+    
+    put_locked(key, hash, value, std::move(new_value), std::chrono::steady_clock::time_point::max(), retired);
+    return true;
+}
+
+int64_t LRUCache::incr_by(std::string_view key, int64_t delta) {
+    return add_to_counter(key, delta, false);
+}
+
+int64_t LRUCache::decr_by(std::string_view key, int64_t delta) {
+    return add_to_counter(key, delta, true);
+}
+
+int64_t LRUCache::add_to_counter(std::string_view key, int64_t delta, bool subtract) {
+    uint64_t hash = hash_key(key);
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired);
+    uint32_t id = find_live_node(key, hash, retired);
+    int64_t current = id != FlatIndex::kNotFound ? nodes_[id].entry.integer : 0;
+    if (id != FlatIndex::kNotFound && nodes_[id].entry.encoding != ValueEncoding::Integer) {
+        std::string_view text = value_view(nodes_[id].entry, nullptr);
+        auto res = std::from_chars(text.data(), text.data() + text.size(), current);
+        if (text.empty() || res.ec != std::errc() || res.ptr != text.data() + text.size()) {
+            throw std::invalid_argument("Value is not an integer");
+        }
+    }
+    // Subtracting directly keeps delta == INT64_MIN valid for negative values
+    int64_t result;
+    if (subtract ? __builtin_sub_overflow(current, delta, &result) : __builtin_add_overflow(current, delta, &result)) {
+        throw std::overflow_error(subtract ? "Decrement would overflow" : "Increment would overflow");
+    }
+    
+    if (id == FlatIndex::kNotFound) {
+        if (capacity != 0 && current_size >= capacity) {
+            evict_one(EvictionReason::Capacity, retired);
+        }
+        make_room(node_charge(key.size()), kNil, retired);
+        id = insert_node(key, hash);
+        nodes_[id].entry.integer = result;
+        return result;
+    }
+    
+    // Switch text to the integer encoding; shared text is released after unlocking
+    CacheEntry& entry = nodes_[id].entry;
+    release_value(entry, retired);
+    entry.integer = result;
+    entry.version = ++last_version_;
+    entry.touch(clock_->ticks());
+    policy_->on_access(id);
+    return result;
+}
+
+
+bool LRUCache::ttl(std::string_view key, std::chrono::milliseconds& remaining) const {
+    uint64_t hash = hash_key(key);
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    uint32_t id = find_node(key, hash);
+    if (id == FlatIndex::kNotFound) {
+        return false;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    const CacheEntry& entry = nodes_[id].entry;
+    if (is_expired(entry)) {
+        return false;
+    }
+    if (entry.expires_at == std::chrono::steady_clock::time_point::max()) {
+        remaining = kNoExpiry;
+    } else {
+        remaining = std::chrono::ceil<std::chrono::milliseconds>(entry.expires_at - now);
+    }
+    return true;
+}
+
+bool LRUCache::inspect(std::string_view key, EntryInfo& info) const {
+    uint64_t hash = hash_key(key);
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    uint32_t id = find_node(key, hash);
+    if (id == FlatIndex::kNotFound || is_expired(nodes_[id].entry)) {
+        return false;
+    }
+    
+    const CacheEntry& entry = nodes_[id].entry;
+    info.encoding = entry.encoding;
+    info.value_size = entry.encoding == ValueEncoding::Integer ? std::to_string(entry.integer).size() : stored_size(entry);
+    info.version = entry.version;
+    info.access_count = entry.access_count();
+    info.referenced = entry.referenced();
+    uint32_t idle_ticks = (clock_->ticks() - entry.last_access_tick()) & CacheEntry::kTickMask;
+    info.idle = idle_ticks * CoarseClock::kTickInterval;
+    if (entry.expires_at == std::chrono::steady_clock::time_point::max()) {
+        info.ttl = kNoExpiry;
+    } else {
+        info.ttl = std::chrono::ceil<std::chrono::milliseconds>(entry.expires_at - std::chrono::steady_clock::now());
+    }
+    return true;
+}
+
+size_t LRUCache::purge_expired() {
+    ValuePtr retired;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    return expire_due(retired);
+}
+
 void LRUCache::clear() {
-    std::unique_lock<std::shared_mutex> lock(mutex_);
-    cache_map.clear();
-    head->next = tail;
-    tail->prev = head;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    reset_entries();
+}
+
+void LRUCache::clear_async() {
+    // Replacements are built before the lock is taken, so the swap is O(1)
+    auto detached = std::make_unique<DetachedEntries>();
+    std::unique_ptr<EvictionPolicy> fresh_policy = make_eviction_policy(options_, nodes_);
+    if (options_.ordered_index) {
+        detached->ordered = std::make_unique<std::map<std::string_view, uint32_t>>();
+    }
+    
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    std::swap(detached->index, index_);
+    std::swap(detached->nodes, nodes_);
+    slab_.swap(detached->slab);
+    std::swap(detached->ordered, ordered_);
+    // The old policy still points at nodes_, which the shard keeps using;
+    // follow its nodes so the reclaimer never sees the live arena
+    policy_->rebind(detached->nodes);
+    detached->policy = std::move(policy_);
+    policy_ = std::move(fresh_policy);
+    wheel_.clear();
+    size_t entries = current_size;
     current_size = 0;
+    used_bytes_ = 0;
+    
+    Reclaimer& reclaimer = reclaimer_locked();
+    lock.unlock();
+    reclaimer.retire(std::move(detached), entries);
+}
+
+bool LRUCache::remove_async(std::string_view key) {
+    uint64_t hash = hash_key(key);
+    ValuePtr retired;
+    ValuePtr removed;
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    expire_due(retired);
+    uint32_t id = find_live_node(key, hash, retired);
+    if (id == FlatIndex::kNotFound) {
+        return false;
+    }
+    policy_->on_remove(id);
+    evict_node(id, EvictionReason::Explicit, removed);
+    
+    if (removed && removed->size() >= kLazyFreeBytes) {
+        Reclaimer& reclaimer = reclaimer_locked();
+        lock.unlock();
+        reclaimer.retire(std::move(removed), 1);
+    }
+    return true;
+}
+
+void LRUCache::range(std::string_view start, std::string_view end, size_t limit, KeyValueList& out) const {
+    if (!ordered_) {
+        throw std::logic_error("Ordered index is not enabled");
+    }
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    // Scans neither count as accesses nor reclaim expired entries
+    size_t found = 0;
+    for (auto it = ordered_->lower_bound(start); it != ordered_->end(); ++it) {
+        if ((!end.empty() && it->first >= end) || (limit != 0 && found == limit)) {
+            break;
+        }
+        const CacheEntry& entry = nodes_[it->second].entry;
+        if (is_expired(entry)) {
+            continue;
+        }
+        out.emplace_back(std::string(it->first), ValueRef(value_of(entry)));
+        found++;
+    }
+}
+
+uint64_t LRUCache::scan(uint64_t cursor, size_t count, KeyValueList& out) const {
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    for (size_t groups = 0; groups < std::max<size_t>(count, 1); ++groups) {
+        cursor = index_.scan(cursor, [&](uint32_t id) {
+            const CacheNode& n = nodes_[id];
+            if (!is_expired(n.entry)) {
+                out.emplace_back(std::string(n.key()), ValueRef(value_of(n.entry)));
+            }
+        });
+        if (cursor == 0) {
+            break;
+        }
+    }
+    return cursor;
 }
 
 size_t LRUCache::size() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
     return current_size;
 }
 
+void LRUCache::slab_usage(size_t& requested_bytes, size_t& reserved_bytes) const {
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    requested_bytes = slab_.requested_bytes();
+    reserved_bytes = slab_.reserved_bytes();
+}
+
+size_t LRUCache::memory_usage() const {
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    return used_bytes_;
+}
+
 bool LRUCache::empty() const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
     return current_size == 0;
 }
 
 void LRUCache::save_snapshot(const std::string& filename) const {
-    std::shared_lock<std::shared_mutex> lock(mutex_);
-    
     std::ofstream file(filename, std::ios::binary);
     if (!file) {
         throw std::runtime_error("Failed to open snapshot file for writing");
     }
     
-    // Write header
+    // Write header; the count is patched once the entries are written
     uint32_t version = 1;
-    uint32_t count = static_cast<uint32_t>(current_size);
+    uint32_t count = 0;
     file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    auto count_pos = file.tellp();
     file.write(reinterpret_cast<const char*>(&count), sizeof(count));
     
-    // Write entries
-    NodePtr current = head->next;
-    while (current != tail) {
-        uint32_t key_size = static_cast<uint32_t>(current->key.size());
-        uint32_t value_size = static_cast<uint32_t>(current->entry->value.size());
+    count = write_entries(file);
+    file.seekp(count_pos);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+}
+
+uint32_t LRUCache::write_entries(std::ostream& out) const {
+    std::shared_lock<InstrumentedSharedMutex> lock(mutex_);
+    
+    // TTLs are not part of the snapshot format; expired entries are skipped
+    // so they do not come back as permanent keys
+    uint32_t count = 0;
+    policy_->for_each([&](uint32_t id) {
+        const CacheNode& current = nodes_[id];
+        if (is_expired(current.entry)) {
+            return;
+        }
+        uint32_t key_size = current.key_size;
+        char digits[20];
+        std::string_view value = value_view(current.entry, digits);
+        uint32_t value_size = static_cast<uint32_t>(value.size());
         
-        file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
-        file.write(current->key.c_str(), key_size);
-        file.write(reinterpret_cast<const char*>(&value_size), sizeof(value_size));
-        file.write(current->entry->value.c_str(), value_size);
+        out.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+        out.write(current.key_data, key_size);
+        out.write(reinterpret_cast<const char*>(&value_size), sizeof(value_size));
+        out.write(value.data(), value_size);
         
-        current = current->next;
-    }
+        count++;
+    });
+    return count;
 }
 
 bool LRUCache::load_snapshot(const std::string& filename) {
@@ -167,13 +1835,10 @@ bool LRUCache::load_snapshot(const std::string& filename) {
         return false;
     }
     
-    std::unique_lock<std::shared_mutex> lock(mutex_);
+    std::unique_lock<InstrumentedSharedMutex> lock(mutex_);
     
     // Clear existing data
-    cache_map.clear();
-    head->next = tail;
-    tail->prev = head;
-    current_size = 0;
+    reset_entries();
     
     // Read header
     uint32_t version, count;
@@ -185,7 +1850,8 @@ bool LRUCache::load_snapshot(const std::string& filename) {
     }
     
     // Read entries
-    for (uint32_t i = 0; i &lt; count && i &lt; capacity; ++i) {
+    ValuePtr retired;
+    for (uint32_t i = 0; i < count && (capacity == 0 || i < capacity); ++i) {
         uint32_t key_size, value_size;
         file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
         
@@ -197,16 +1863,15 @@ bool LRUCache::load_snapshot(const std::string& filename) {
         file.read(&value[0], value_size);
         
         // Add to cache (without lock since we already have it)
-        auto entry = std::make_shared<CacheEntry>(value);
-        auto node = std::make_shared<Node>(key, entry);
-        
-        node->next = head->next;
-        node->prev = head;
-        head->next->prev = node;
-        head->next = node;
-        
-        cache_map[key] = node;
-        current_size++;
+        uint64_t hash = hash_key(key);
+        if (find_node(key, hash) == FlatIndex::kNotFound) {
+            ValuePtr shared = share_if_long(value);
+            make_room(node_charge(key.size()) + value_charge(value.size(), shared ? ValueEncoding::Shared : ValueEncoding::Inline),
+                      kNil, retired);
+            uint32_t id = insert_node(key, hash);
+            assign_value(nodes_[id].entry, value, std::move(shared), retired);
+            retired.reset();
+        }
     }
     
     return true;
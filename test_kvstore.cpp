@@ -3,6 +3,10 @@
 #include <thread>
 #include <vector>
 #include <random>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <set>
 
 class KVStoreTest : public ::testing::Test {
 protected:
@@ -93,9 +97,9 @@ TEST_F(KVStoreTest, ConcurrentAccess) {
     std::atomic<int> success_count{0};
     
     // Launch multiple threads
-    for (int i = 0; i &lt; num_threads; ++i) {
+    for (int i = 0; i < num_threads; ++i) {
         threads.emplace_back([this, i, operations_per_thread, &success_count]() {
-            for (int j = 0; j &lt; operations_per_thread; ++j) {
+            for (int j = 0; j < operations_per_thread; ++j) {
                 std::string key = "thread_" + std::to_string(i) + "_key_" + std::to_string(j);
                 std::string value = "value_" + std::to_string(j);
                 
@@ -172,7 +176,7 @@ TEST_F(KVStoreTest, StressTest) {
     std::uniform_int_distribution<> key_dis(1, 1000);
     std::uniform_int_distribution<> op_dis(1, 3);
     
-    for (int i = 0; i &lt; num_operations; ++i) {
+    for (int i = 0; i < num_operations; ++i) {
         std::string key = "stress_key_" + std::to_string(key_dis(gen));
         int operation = op_dis(gen);
         
@@ -199,6 +203,1175 @@ TEST_F(KVStoreTest, StressTest) {
     EXPECT_EQ(value, "final_value");
 }
 
+TEST_F(KVStoreTest, ShardedStore) {
+    auto sharded = std::make_unique<kvstore::KVStore>(1000, "", 8);
+    EXPECT_EQ(sharded->shard_count(), 8);
+    
+    for (int i = 0; i < 500; ++i) {
+        sharded->put("key_" + std::to_string(i), "value_" + std::to_string(i));
+    }
+    EXPECT_EQ(sharded->size(), 500);
+    
+    std::string value;
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_TRUE(sharded->get("key_" + std::to_string(i), value));
+        EXPECT_EQ(value, "value_" + std::to_string(i));
+    }
+    EXPECT_EQ(sharded->get_metrics().cache_hits.load(), 500);
+    
+    ASSERT_TRUE(sharded->remove("key_0"));
+    EXPECT_EQ(sharded->size(), 499);
+    
+    sharded->clear();
+    EXPECT_TRUE(sharded->empty());
+    
+    EXPECT_THROW(kvstore::KVStore(4, "", 8), std::invalid_argument);
+}
+
+TEST_F(KVStoreTest, ShardedSnapshot) {
+    const std::string snapshot_file = "test_sharded_snapshot.dat";
+    
+    {
+        kvstore::KVStore sharded(100, snapshot_file, 4);
+        for (int i = 0; i < 50; ++i) {
+            sharded.put("key_" + std::to_string(i), "value_" + std::to_string(i));
+        }
+        sharded.save_snapshot();
+    }
+    
+    // Reload with a different shard count; records are re-routed by hash
+    kvstore::KVStore reloaded(100, snapshot_file, 3);
+    EXPECT_EQ(reloaded.size(), 50);
+    
+    std::string value;
+    ASSERT_TRUE(reloaded.get("key_42", value));
+    EXPECT_EQ(value, "value_42");
+    
+    std::remove(snapshot_file.c_str());
+}
+
+TEST_F(KVStoreTest, ClockRecencySecondChance) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 3;
+    options.recency = kvstore::RecencyMode::Clock;
+    kvstore::KVStore clock_store(options);
+    
+    clock_store.put("key1", "value1");
+    clock_store.put("key2", "value2");
+    clock_store.put("key3", "value3");
+    
+    // key1 is referenced, so it survives and key2 becomes the victim
+    std::string value;
+    ASSERT_TRUE(clock_store.get("key1", value));
+    kvstore::EntryInfo before;
+    ASSERT_TRUE(clock_store.inspect("key1", before));
+    clock_store.put("key4", "value4");
+    
+    // The second chance is not an access
+    kvstore::EntryInfo after;
+    ASSERT_TRUE(clock_store.inspect("key1", after));
+    EXPECT_EQ(after.access_count, before.access_count);
+    
+    EXPECT_EQ(clock_store.size(), 3);
+    ASSERT_TRUE(clock_store.get("key1", value));
+    EXPECT_EQ(value, "value1");
+    ASSERT_FALSE(clock_store.get("key2", value));
+    ASSERT_TRUE(clock_store.get("key3", value));
+    ASSERT_TRUE(clock_store.get("key4", value));
+}
+
+TEST_F(KVStoreTest, ClockRecencyConcurrentReads) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 1000;
+    options.recency = kvstore::RecencyMode::Clock;
+    kvstore::KVStore clock_store(options);
+    
+    for (int i = 0; i < 100; ++i) {
+        clock_store.put("key_" + std::to_string(i), "value_" + std::to_string(i));
+    }
+    
+    std::atomic<int> success_count{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&clock_store, &success_count]() {
+            std::string value;
+            for (int j = 0; j < 1000; ++j) {
+                int i = j % 100;
+                if (clock_store.get("key_" + std::to_string(i), value) &&
+                    value == "value_" + std::to_string(i)) {
+                    success_count++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    EXPECT_EQ(success_count.load(), 8 * 1000);
+}
+
+TEST_F(KVStoreTest, StringViewKeys) {
+    // Keys that are slices of a larger buffer, not null-terminated strings
+    const char buffer[] = "user:42:profile|user:43:profile";
+    std::string_view key1(buffer, 15);
+    std::string_view key2(buffer + 16, 15);
+    
+    store->put(key1, std::string_view("alice"));
+    store->put(key2, "bob");
+    
+    std::string value;
+    ASSERT_TRUE(store->get("user:42:profile", value));
+    EXPECT_EQ(value, "alice");
+    ASSERT_TRUE(store->get(std::string("user:43:profile"), value));
+    EXPECT_EQ(value, "bob");
+    ASSERT_FALSE(store->get(std::string_view(buffer, 7), value));
+    
+    ASSERT_TRUE(store->remove(key1));
+    ASSERT_FALSE(store->get(key1, value));
+}
+
+TEST_F(KVStoreTest, PinnedValueRef) {
+    std::string blob(64 * 1024, 'x');
+    store->put("blob", blob);
+    
+    kvstore::ValueRef ref = store->get_ref("blob");
+    ASSERT_TRUE(ref);
+    EXPECT_EQ(ref.size(), blob.size());
+    EXPECT_EQ(ref.view(), blob);
+    
+    // The handle keeps the old bytes alive across overwrite and removal
+    store->put("blob", "replaced");
+    EXPECT_EQ(ref.view(), blob);
+    ASSERT_TRUE(store->remove("blob"));
+    EXPECT_EQ(ref.view(), blob);
+    
+    EXPECT_FALSE(store->get_ref("blob"));
+    EXPECT_EQ(store->get_metrics().cache_hits.load(), 1);
+    EXPECT_EQ(store->get_metrics().cache_misses.load(), 1);
+}
+
+// Writes 200 600-byte values under an 8 KiB budget, reading back the last
+// few keys after each write so reference bits are set. Returns how many keys
+// were missing right after their own put.
+static int missing_after_budgeted_puts(kvstore::EvictionPolicyType policy, kvstore::RecencyMode recency) {
+    kvstore::CacheOptions options;
+    options.capacity = 0;
+    options.max_memory_bytes = 8 * 1024;
+    options.policy = policy;
+    options.recency = recency;
+    kvstore::LRUCache cache(options);
+    
+    int missing = 0;
+    std::string value;
+    for (int i = 0; i < 200; ++i) {
+        std::string key = "key_" + std::to_string(i);
+        cache.put(key, std::string(600, 'v'));
+        if (!cache.get(key, value)) {
+            missing++;
+        }
+        for (int j = std::max(0, i - 3); j < i; ++j) {
+            cache.get("key_" + std::to_string(j), value);
+        }
+        EXPECT_LE(cache.memory_usage(), options.max_memory_bytes);
+    }
+    return missing;
+}
+
+TEST(LRUCacheTest, MemoryBudgetKeepsWrittenKeyClock) {
+    EXPECT_EQ(missing_after_budgeted_puts(kvstore::EvictionPolicyType::LRU, kvstore::RecencyMode::Clock), 0);
+    EXPECT_EQ(missing_after_budgeted_puts(kvstore::EvictionPolicyType::LRU, kvstore::RecencyMode::Strict), 0);
+}
+
+TEST(LRUCacheTest, MemoryBudgetKeepsWrittenKeyArcAndSlru) {
+    EXPECT_EQ(missing_after_budgeted_puts(kvstore::EvictionPolicyType::ARC, kvstore::RecencyMode::Strict), 0);
+    EXPECT_EQ(missing_after_budgeted_puts(kvstore::EvictionPolicyType::SLRU, kvstore::RecencyMode::Strict), 0);
+}
+
+TEST(LRUCacheTest, MemoryBudgetKeepsWrittenKeySieve) {
+    EXPECT_EQ(missing_after_budgeted_puts(kvstore::EvictionPolicyType::SIEVE, kvstore::RecencyMode::Strict), 0);
+}
+
+TEST_F(KVStoreTest, MemoryBudgetEviction) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 0;  // No entry limit, bytes only
+    options.max_memory_bytes = 64 * 1024;
+    kvstore::KVStore budget_store(options);
+    
+    std::string big(10 * 1024, 'b');
+    for (int i = 0; i < 20; ++i) {
+        budget_store.put("big_" + std::to_string(i), big);
+        EXPECT_LE(budget_store.memory_usage(), options.max_memory_bytes);
+    }
+    
+    // Only the most recent ~6 values fit; the oldest were evicted from the tail
+    EXPECT_LT(budget_store.size(), 7u);
+    std::string value;
+    ASSERT_FALSE(budget_store.get("big_0", value));
+    ASSERT_TRUE(budget_store.get("big_19", value));
+    
+    // Small entries are accounted with their per-entry overhead
+    budget_store.clear();
+    EXPECT_EQ(budget_store.memory_usage(), 0u);
+    budget_store.put("k", "v");
+    EXPECT_GT(budget_store.get_metrics().memory_used_bytes.load(), 2u);
+    
+    // Growing a value in place also triggers eviction
+    budget_store.put("a", std::string(30 * 1024, 'a'));
+    budget_store.put("b", std::string(30 * 1024, 'b'));
+    budget_store.put("k", std::string(30 * 1024, 'k'));
+    EXPECT_LE(budget_store.memory_usage(), options.max_memory_bytes);
+    ASSERT_FALSE(budget_store.get("a", value));
+}
+
+TEST_F(KVStoreTest, PoliciesResistScans) {
+    auto hot_survivors = [](kvstore::EvictionPolicyType policy) {
+        kvstore::KVStoreOptions options;
+        options.capacity = 100;
+        options.policy = policy;
+        kvstore::KVStore policy_store(options);
+        
+        // Build up frequency for a hot set that fits in the cache
+        std::string value;
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 50; ++i) {
+                std::string key = "hot_" + std::to_string(i);
+                if (!policy_store.get(key, value)) {
+                    policy_store.put(key, "v");
+                }
+            }
+        }
+        
+        // One large scan of keys that are never seen again
+        for (int i = 0; i < 1000; ++i) {
+            policy_store.put("scan_" + std::to_string(i), "v");
+        }
+        EXPECT_EQ(policy_store.size(), 100u);
+        
+        int survivors = 0;
+        for (int i = 0; i < 50; ++i) {
+            survivors += policy_store.get("hot_" + std::to_string(i), value);
+        }
+        return survivors;
+    };
+    
+    EXPECT_EQ(hot_survivors(kvstore::EvictionPolicyType::LRU), 0);
+    EXPECT_GE(hot_survivors(kvstore::EvictionPolicyType::WTinyLFU), 45);
+    EXPECT_EQ(hot_survivors(kvstore::EvictionPolicyType::SLRU), 50);
+    EXPECT_EQ(hot_survivors(kvstore::EvictionPolicyType::ARC), 50);
+}
+
+TEST_F(KVStoreTest, SlruPromotesOnRepeatAccess) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 10;
+    options.policy = kvstore::EvictionPolicyType::SLRU;
+    kvstore::KVStore slru_store(options);
+    
+    for (int i = 0; i < 10; ++i) {
+        slru_store.put("key" + std::to_string(i), "v");
+    }
+    
+    // One hit protects key0; key1 was only inserted and stays on probation
+    std::string value;
+    ASSERT_TRUE(slru_store.get("key0", value));
+    for (int i = 10; i < 30; ++i) {
+        slru_store.put("key" + std::to_string(i), "v");
+    }
+    
+    EXPECT_TRUE(slru_store.get("key0", value));
+    EXPECT_FALSE(slru_store.get("key1", value));
+}
+
+TEST_F(KVStoreTest, ArcAdaptsToGhostHits) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 10;
+    options.policy = kvstore::EvictionPolicyType::ARC;
+    kvstore::KVStore arc_store(options);
+    
+    // Fill T2 with keys hit twice, then cycle through a working set slightly
+    // larger than what is left for T1. Misses on recently evicted keys hit
+    // ghost list B1 and grow T1, so the cycle starts hitting.
+    std::string value;
+    for (int i = 0; i < 5; ++i) {
+        arc_store.put("old" + std::to_string(i), "v");
+        arc_store.get("old" + std::to_string(i), value);
+    }
+    int hits = 0;
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 8; ++i) {
+            std::string key = "cycle" + std::to_string(i);
+            if (arc_store.get(key, value)) {
+                hits += round >= 10;
+            } else {
+                arc_store.put(key, "v");
+            }
+        }
+    }
+    EXPECT_GT(hits, 60);
+}
+
+TEST_F(KVStoreTest, SieveKeepsVisitedEntries) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 4;
+    options.policy = kvstore::EvictionPolicyType::SIEVE;
+    kvstore::KVStore sieve_store(options);
+    
+    std::string value;
+    for (const char* key : {"a", "b", "c", "d"}) {
+        sieve_store.put(key, "v");
+    }
+    ASSERT_TRUE(sieve_store.get("a", value));
+    ASSERT_TRUE(sieve_store.get("b", value));
+    
+    // The hand clears a and b and evicts c, then keeps moving toward the
+    // newest entries (d, e) instead of returning to a as LRU would
+    for (const char* key : {"e", "f", "g"}) {
+        sieve_store.put(key, "v");
+    }
+    for (const char* key : {"a", "b", "f", "g"}) {
+        EXPECT_TRUE(sieve_store.get(key, value)) << key;
+    }
+    for (const char* key : {"c", "d", "e"}) {
+        EXPECT_FALSE(sieve_store.get(key, value)) << key;
+    }
+}
+
+TEST_F(KVStoreTest, EvictionPolicyNames) {
+    kvstore::EvictionPolicyType type;
+    ASSERT_TRUE(kvstore::parse_eviction_policy("wtinylfu", type));
+    EXPECT_EQ(type, kvstore::EvictionPolicyType::WTinyLFU);
+    ASSERT_TRUE(kvstore::parse_eviction_policy("arc", type));
+    EXPECT_EQ(type, kvstore::EvictionPolicyType::ARC);
+    EXPECT_STREQ(kvstore::eviction_policy_name(kvstore::EvictionPolicyType::SLRU), "slru");
+    ASSERT_TRUE(kvstore::parse_eviction_policy("sieve", type));
+    EXPECT_EQ(type, kvstore::EvictionPolicyType::SIEVE);
+    EXPECT_STREQ(kvstore::eviction_policy_name(kvstore::EvictionPolicyType::LRU), "lru");
+    EXPECT_FALSE(kvstore::parse_eviction_policy("fifo", type));
+}
+
+TEST_F(KVStoreTest, KeyExpiry) {
+    using namespace std::chrono_literals;
+    std::string value;
+    std::chrono::milliseconds remaining;
+    
+    store->put("session", "data", 30ms);
+    store->put("permanent", "data");
+    ASSERT_TRUE(store->ttl("session", remaining));
+    EXPECT_GT(remaining.count(), 0);
+    EXPECT_LE(remaining.count(), 30);
+    ASSERT_TRUE(store->ttl("permanent", remaining));
+    EXPECT_EQ(remaining, kvstore::kNoExpiry);
+    EXPECT_FALSE(store->ttl("missing", remaining));
+    
+    // EXPIRE on an existing key; a plain PUT clears the TTL again
+    EXPECT_TRUE(store->expire("permanent", 30ms));
+    EXPECT_FALSE(store->expire("missing", 30ms));
+    store->put("reset", "data", 30ms);
+    store->put("reset", "data");
+    
+    std::this_thread::sleep_for(60ms);
+    EXPECT_FALSE(store->get("session", value));
+    EXPECT_FALSE(store->get("permanent", value));
+    EXPECT_FALSE(store->ttl("session", remaining));
+    ASSERT_TRUE(store->get("reset", value));
+    
+    EXPECT_TRUE(store->expire("reset", 0ms));
+    EXPECT_FALSE(store->get("reset", value));
+    EXPECT_THROW(store->put("bad", "data", 0ms), std::invalid_argument);
+}
+
+TEST_F(KVStoreTest, HugeTtlNeverExpires) {
+    std::string value;
+    std::chrono::milliseconds remaining;
+    
+    // now + ttl would overflow the clock; it must not wrap into the past
+    store->put("forever", "data", std::chrono::milliseconds::max());
+    ASSERT_TRUE(store->get("forever", value));
+    ASSERT_TRUE(store->ttl("forever", remaining));
+    EXPECT_EQ(remaining, kvstore::kNoExpiry);
+    
+    store->put("later", "data");
+    // A thousand years fits in milliseconds but not in steady_clock's nanoseconds
+    EXPECT_TRUE(store->expire("later", std::chrono::hours(24 * 365 * 1000)));
+    ASSERT_TRUE(store->ttl("later", remaining));
+    EXPECT_EQ(remaining, kvstore::kNoExpiry);
+    EXPECT_TRUE(store->expire("later", std::chrono::milliseconds::max()));
+    store->purge_expired();
+    EXPECT_TRUE(store->get("later", value));
+    EXPECT_TRUE(store->get("forever", value));
+}
+
+TEST_F(KVStoreTest, TimingWheelReclaimsExpiredKeys) {
+    using namespace std::chrono_literals;
+    
+    for (int i = 0; i < 50; ++i) {
+        store->put("short_" + std::to_string(i), "v", 50ms);
+    }
+    store->put("long", "v", 1h);
+    store->put("permanent", "v");
+    EXPECT_EQ(store->size(), 52u);
+    
+    // Nothing reads the keys, so only the wheel can reclaim them. The
+    // background expiry task may get to some of them before the explicit
+    // purge does; either way they are all gone afterwards.
+    std::this_thread::sleep_for(80ms);
+    EXPECT_LE(store->purge_expired(), 50u);
+    EXPECT_EQ(store->size(), 2u);
+    kvstore::EntryInfo info;
+    EXPECT_TRUE(store->inspect("long", info));
+    EXPECT_TRUE(store->inspect("permanent", info));
+}
+
+TEST(TimingWheelTest, FiresAtDeadline) {
+    using Clock = std::chrono::steady_clock;
+    kvstore::NodeArena nodes;
+    kvstore::TimingWheel wheel(nodes);
+    Clock::time_point base = Clock::now();
+    
+    // Deadlines from 1 ms to ~35 years: every level and past the top one
+    std::mt19937_64 gen(3);
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < 2000; ++i) {
+        uint32_t id = nodes.allocate();
+        uint64_t ms = 1 + gen() % (uint64_t(1) << (i % 40 + 1));
+        nodes[id].entry.expires_at = base + std::chrono::milliseconds(ms);
+        wheel.schedule(id);
+        ids.push_back(id);
+    }
+    uint32_t cancelled = ids.back();
+    wheel.cancel(cancelled);
+    EXPECT_EQ(wheel.size(), ids.size() - 1);
+    
+    // Step through time in growing strides; every timer fires once, never
+    // before its deadline and within one tick after it
+    std::vector<uint32_t> due;
+    std::vector<bool> fired(ids.size());
+    Clock::time_point now = base;
+    for (uint64_t stride = 1; wheel.size() != 0; stride = stride * 3 / 2 + 1) {
+        now += std::chrono::milliseconds(stride);
+        due.clear();
+        wheel.advance(now, due);
+        for (uint32_t id : due) {
+            ASSERT_NE(id, cancelled);
+            ASSERT_FALSE(fired[id]);
+            fired[id] = true;
+            EXPECT_LE(nodes[id].entry.expires_at, now);
+            EXPECT_GT(nodes[id].entry.expires_at + std::chrono::milliseconds(stride + 1), now);
+        }
+    }
+    EXPECT_EQ(std::count(fired.begin(), fired.end(), true), static_cast<long>(ids.size() - 1));
+}
+
+TEST_F(KVStoreTest, MultiGetMultiPut) {
+    kvstore::KVStore sharded(1000, "", 4);
+    
+    std::vector<std::string> keys;
+    std::vector<std::pair<std::string_view, std::string_view>> entries;
+    for (int i = 0; i < 100; ++i) {
+        keys.push_back("key" + std::to_string(i));
+    }
+    for (const auto& key : keys) {
+        entries.emplace_back(key, key);
+    }
+    sharded.multi_put(entries);
+    EXPECT_EQ(sharded.size(), 100u);
+    sharded.reset_metrics();
+    
+    // Results line up with the requested order across shards, misses included
+    std::vector<std::string_view> request = {"key7", "missing", "key42", "key7", "key99"};
+    std::vector<kvstore::ValueRef> values = sharded.multi_get(request);
+    ASSERT_EQ(values.size(), request.size());
+    EXPECT_EQ(values[0].view(), "key7");
+    EXPECT_FALSE(values[1]);
+    EXPECT_EQ(values[2].view(), "key42");
+    EXPECT_EQ(values[3].view(), "key7");
+    EXPECT_EQ(values[4].view(), "key99");
+    
+    const auto& metrics = sharded.get_metrics();
+    EXPECT_EQ(metrics.total_operations.load(), 5u);
+    EXPECT_EQ(metrics.cache_hits.load(), 4u);
+    EXPECT_EQ(metrics.cache_misses.load(), 1u);
+    
+    // A repeated key in one batch keeps the last value
+    sharded.multi_put({{"dup", "first"}, {"dup", "second"}});
+    std::string value;
+    ASSERT_TRUE(sharded.get("dup", value));
+    EXPECT_EQ(value, "second");
+    
+    // Overflowing the capacity in a batch evicts and is counted
+    store->multi_put(entries);
+    store->multi_put({{"extra1", "v"}, {"extra2", "v"}});
+    EXPECT_EQ(store->size(), 100u);
+    EXPECT_EQ(store->get_metrics().evictions.load(), 2u);
+}
+
+TEST_F(KVStoreTest, GetOrLoadCoalescesMisses) {
+    std::atomic<int> loader_calls{0};
+    std::atomic<bool> release{false};
+    auto loader = [&](std::string_view key) {
+        loader_calls++;
+        while (!release) {
+            std::this_thread::yield();
+        }
+        return "loaded:" + std::string(key);
+    };
+    
+    // Every thread misses on the same key while the first load is blocked
+    const int num_threads = 8;
+    std::vector<std::thread> threads;
+    std::vector<std::string> results(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            results[t] = store->get_or_load("hot", loader).str();
+        });
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (store->get_metrics().coalesced_waits.load() < num_threads - 1 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    release = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    EXPECT_EQ(loader_calls.load(), 1);
+    for (const auto& result : results) {
+        EXPECT_EQ(result, "loaded:hot");
+    }
+    const auto& metrics = store->get_metrics();
+    EXPECT_EQ(metrics.loads.load(), 1u);
+    EXPECT_EQ(metrics.coalesced_waits.load(), static_cast<uint64_t>(num_threads - 1));
+    
+    // Later reads hit the cache without calling the loader
+    EXPECT_EQ(store->get_or_load("hot", loader).view(), "loaded:hot");
+    EXPECT_EQ(loader_calls.load(), 1);
+    
+    // A failing loader propagates its exception and caches nothing
+    auto failing = [](std::string_view) -> std::string { throw std::runtime_error("backend down"); };
+    EXPECT_THROW(store->get_or_load("cold", failing), std::runtime_error);
+    std::string value;
+    EXPECT_FALSE(store->get("cold", value));
+}
+
+TEST_F(KVStoreTest, CompareAndSet) {
+    std::string value;
+    uint64_t version = 0;
+    
+    // Version 0 only matches an absent key
+    ASSERT_TRUE(store->compare_and_set("counter", 0, "1"));
+    EXPECT_FALSE(store->compare_and_set("counter", 0, "x"));
+    ASSERT_TRUE(store->get("counter", value, version));
+    EXPECT_EQ(value, "1");
+    EXPECT_NE(version, 0u);
+    
+    // Any write changes the version, so a stale token fails
+    uint64_t stale = version;
+    store->put("counter", "2");
+    ASSERT_TRUE(store->get("counter", value, version));
+    EXPECT_NE(version, stale);
+    EXPECT_FALSE(store->compare_and_set("counter", stale, "3"));
+    EXPECT_TRUE(store->compare_and_set("counter", version, "3"));
+    
+    // A deleted and re-created key does not reuse its old version
+    ASSERT_TRUE(store->get("counter", value, version));
+    store->remove("counter");
+    store->put("counter", "3");
+    EXPECT_FALSE(store->compare_and_set("counter", version, "4"));
+}
+
+TEST_F(KVStoreTest, CompareAndSetConcurrentIncrements) {
+    store->put("counter", "0");
+    
+    const int num_threads = 8;
+    const int increments = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < increments; ++i) {
+                std::string value;
+                uint64_t version;
+                do {
+                    ASSERT_TRUE(store->get("counter", value, version));
+                } while (!store->compare_and_set("counter", version, std::to_string(std::stoi(value) + 1)));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    std::string value;
+    ASSERT_TRUE(store->get("counter", value));
+    EXPECT_EQ(value, std::to_string(num_threads * increments));
+}
+
+TEST_F(KVStoreTest, IntegerCounters) {
+    std::string value;
+    
+    // Missing keys count from zero
+    EXPECT_EQ(store->incr_by("hits", 1), 1);
+    EXPECT_EQ(store->incr_by("hits", 41), 42);
+    EXPECT_EQ(store->decr_by("hits", 2), 40);
+    ASSERT_TRUE(store->get("hits", value));
+    EXPECT_EQ(value, "40");
+    EXPECT_EQ(store->get_ref("hits").view(), "40");
+    
+    // Decimal text converts; a put turns the counter back into text
+    store->put("text", "-7");
+    EXPECT_EQ(store->incr_by("text", 10), 3);
+    store->put("text", "abc");
+    EXPECT_THROW(store->incr_by("text", 1), std::invalid_argument);
+    store->put("text", "12 ");
+    EXPECT_THROW(store->incr_by("text", 1), std::invalid_argument);
+    ASSERT_TRUE(store->get("text", value));
+    EXPECT_EQ(value, "12 ");
+    
+    store->put("big", std::to_string(INT64_MAX));
+    EXPECT_THROW(store->incr_by("big", 1), std::overflow_error);
+    EXPECT_THROW(store->decr_by("hits", INT64_MIN), std::overflow_error);
+    store->put("negative", "-1");
+    EXPECT_EQ(store->decr_by("negative", INT64_MIN), INT64_MAX);
+    EXPECT_EQ(store->decr_by("fresh", 5), -5);
+    ASSERT_TRUE(store->get("big", value));
+    EXPECT_EQ(value, std::to_string(INT64_MAX));
+}
+
+TEST_F(KVStoreTest, IntegerCountersConcurrent) {
+    const int num_threads = 8;
+    const int increments = 1000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < increments; ++i) {
+                store->incr_by("counter", 1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    std::string value;
+    ASSERT_TRUE(store->get("counter", value));
+    EXPECT_EQ(value, std::to_string(num_threads * increments));
+}
+
+TEST_F(KVStoreTest, OrderedScanAndRange) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 100;
+    options.num_shards = 4;
+    options.ordered_index = true;
+    kvstore::KVStore ordered(options);
+    
+    for (const char* key : {"user:2:a", "user:1:b", "user:12:x", "user:1:a", "other", "user:"}) {
+        ordered.put(key, std::string("v_") + key);
+    }
+    
+    auto keys_of = [](const kvstore::KeyValueList& entries) {
+        std::vector<std::string> keys;
+        for (const auto& entry : entries) {
+            keys.push_back(entry.first);
+        }
+        return keys;
+    };
+    
+    kvstore::KeyValueList entries = ordered.scan("user:1:");
+    EXPECT_EQ(keys_of(entries), (std::vector<std::string>{"user:1:a", "user:1:b"}));
+    EXPECT_EQ(entries[0].second.view(), "v_user:1:a");
+    EXPECT_EQ(keys_of(ordered.scan("user:", 3)), (std::vector<std::string>{"user:", "user:12:x", "user:1:a"}));
+    EXPECT_EQ(keys_of(ordered.range("user:1", "user:2")),
+              (std::vector<std::string>{"user:12:x", "user:1:a", "user:1:b"}));
+    EXPECT_TRUE(ordered.range("z", "a").empty());
+    EXPECT_EQ(keys_of(ordered.range("user:12", "")),
+              (std::vector<std::string>{"user:12:x", "user:1:a", "user:1:b", "user:2:a"}));
+    EXPECT_EQ(ordered.scan("").size(), 6u);
+    
+    // Removals, expiry and evictions drop keys from the index
+    ordered.remove("user:1:a");
+    ordered.expire("user:1:b", std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(ordered.scan("user:1:").empty());
+    for (int i = 0; i < 200; ++i) {
+        ordered.put("fill:" + std::to_string(i), "v");
+    }
+    ordered.purge_expired();
+    EXPECT_EQ(ordered.size(), 100u);
+    EXPECT_EQ(ordered.scan("").size(), 100u);
+    
+    // Without the index, ordered queries are an error
+    EXPECT_THROW(store->scan("user:"), std::logic_error);
+}
+
+TEST_F(KVStoreTest, CursorScanSurvivesResize) {
+    kvstore::KVStore sharded(1000000, "", 4);
+    for (int i = 0; i < 1000; ++i) {
+        sharded.put("orig_" + std::to_string(i), "v");
+    }
+    
+    // Insert enough keys between calls to grow every shard's index several
+    // times; all original keys must still be returned
+    std::set<std::string> seen;
+    uint64_t cursor = 0;
+    int calls = 0;
+    int added = 0;
+    do {
+        kvstore::KeyValueList entries;
+        cursor = sharded.scan(cursor, 4, entries);
+        for (const auto& entry : entries) {
+            seen.insert(entry.first);
+        }
+        for (int i = 0; i < 200; ++i) {
+            sharded.put("new_" + std::to_string(added++), "v");
+        }
+        ASSERT_LT(++calls, 100000);
+    } while (cursor != 0);
+    EXPECT_GT(sharded.size(), 4000u);
+    
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(seen.count("orig_" + std::to_string(i))) << i;
+    }
+    kvstore::KeyValueList entries;
+    EXPECT_THROW(sharded.scan(uint64_t(9) << 48, 1, entries), std::invalid_argument);
+    
+    // Shard indexes must fit the cursor's top 16 bits
+    size_t too_many = kvstore::KVStore::kMaxShards + 1;
+    EXPECT_THROW(kvstore::KVStore(too_many, "", too_many), std::invalid_argument);
+}
+
+TEST_F(KVStoreTest, InlineAndSharedValues) {
+    // Values switch between slab-inline, shared and integer encodings
+    std::string long_value(kvstore::CacheEntry::kInlineValueMax + 1, 'x');
+    std::string value;
+    
+    store->put("k", "short");
+    kvstore::ValueRef pinned = store->get_ref("k");
+    store->put("k", long_value);
+    EXPECT_EQ(pinned.view(), "short");
+    ASSERT_TRUE(store->get("k", value));
+    EXPECT_EQ(value, long_value);
+    
+    kvstore::ValueRef shared = store->get_ref("k");
+    store->put("k", "41");
+    EXPECT_EQ(shared.view(), long_value);
+    EXPECT_EQ(store->incr_by("k", 1), 42);
+    store->put("k", "");
+    ASSERT_TRUE(store->get("k", value));
+    EXPECT_EQ(value, "");
+    
+    const auto& metrics = store->get_metrics();
+    EXPECT_GT(metrics.slab_requested_bytes, 0u);
+    EXPECT_GE(metrics.fragmentation_ratio(), 1.0);
+    
+    store->clear();
+    EXPECT_EQ(store->get_metrics().slab_reserved_bytes, 0u);
+}
+
+TEST(LRUCacheTest, MemoryChargeFollowsEncoding) {
+    kvstore::LRUCache cache(10);
+    
+    // Inline values are charged their slab slot: 9 and 16 bytes share one class
+    cache.put("k", std::string(9, 'a'));
+    size_t slot16 = cache.memory_usage();
+    cache.put("k", std::string(16, 'a'));
+    EXPECT_EQ(cache.memory_usage(), slot16);
+    cache.put("k", std::string(17, 'a'));
+    EXPECT_EQ(cache.memory_usage(), slot16 + 8);
+    
+    // Integers live in the entry; shared values carry their string overhead
+    cache.put("k", "7");
+    size_t slot8 = cache.memory_usage();
+    cache.incr_by("k", 1);
+    EXPECT_EQ(cache.memory_usage(), slot8 - 8);
+    size_t long_size = kvstore::CacheEntry::kInlineValueMax + 1;
+    cache.put("k", std::string(long_size, 'x'));
+    EXPECT_GT(cache.memory_usage(), slot8 - 8 + long_size + sizeof(std::string));
+    
+    cache.remove("k");
+    EXPECT_EQ(cache.memory_usage(), 0u);
+}
+
+TEST_F(KVStoreTest, InspectReportsEntryMetadata) {
+    kvstore::EntryInfo info;
+    EXPECT_FALSE(store->inspect("missing", info));
+    
+    store->put("key", "value");
+    std::string value;
+    uint64_t version;
+    ASSERT_TRUE(store->get("key", value, version));
+    ASSERT_TRUE(store->inspect("key", info));
+    EXPECT_EQ(info.encoding, kvstore::ValueEncoding::Inline);
+    EXPECT_EQ(info.value_size, 5u);
+    EXPECT_EQ(info.version, version);
+    EXPECT_EQ(info.access_count, 2u);
+    EXPECT_EQ(info.ttl, kvstore::kNoExpiry);
+    
+    // Idle time advances with the coarse clock; inspecting is not an access
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(store->inspect("key", info));
+    EXPECT_GE(info.idle, std::chrono::milliseconds(50));
+    EXPECT_EQ(info.access_count, 2u);
+    ASSERT_TRUE(store->get("key", value));
+    ASSERT_TRUE(store->inspect("key", info));
+    EXPECT_LT(info.idle, std::chrono::milliseconds(50));
+    
+    store->incr_by("counter", 12345);
+    ASSERT_TRUE(store->inspect("counter", info));
+    EXPECT_EQ(info.encoding, kvstore::ValueEncoding::Integer);
+    EXPECT_EQ(info.value_size, 5u);
+}
+
+TEST_F(KVStoreTest, AsyncClearAndRemove) {
+    kvstore::KVStore sharded(200000, "", 4);
+    std::string big(kvstore::LRUCache::kLazyFreeBytes, 'b');
+    // Values past the inline limit each own a buffer, so the reclaimer has
+    // real work to do after clear_async
+    std::string shared(kvstore::CacheEntry::kInlineValueMax + 1, 's');
+    for (int i = 0; i < 100000; ++i) {
+        sharded.put("key" + std::to_string(i), i < 10000 && i % 100 == 0 ? big : shared);
+    }
+    
+    EXPECT_TRUE(sharded.remove_async("key0"));
+    EXPECT_FALSE(sharded.remove_async("key0"));
+    std::string value;
+    EXPECT_FALSE(sharded.get("key0", value));
+    
+    // Pinned values outlive the detached structures
+    kvstore::ValueRef pinned = sharded.get_ref("key100");
+    sharded.clear_async();
+    // The shards hand their entries to the store's reclaimer, which is still
+    // freeing them
+    EXPECT_GT(sharded.get_metrics().reclaim_backlog, 0u);
+    EXPECT_EQ(sharded.size(), 0u);
+    EXPECT_FALSE(sharded.get("key1", value));
+    EXPECT_EQ(pinned.view(), big);
+    
+    // The store stays usable while the reclaimer works
+    sharded.put("after", "value");
+    ASSERT_TRUE(sharded.get("after", value));
+    EXPECT_EQ(value, "value");
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (sharded.get_metrics().reclaim_backlog != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(sharded.get_metrics().reclaim_backlog, 0u);
+    EXPECT_EQ(sharded.size(), 1u);
+}
+
+TEST_F(KVStoreTest, EvictionReasonsAndCallback) {
+    std::vector<std::pair<std::string, kvstore::EvictionReason>> evicted;
+    std::vector<std::string> values;
+    kvstore::KVStoreOptions options;
+    options.capacity = 2;
+    options.max_memory_bytes = 64 * 1024;
+    options.on_evict = [&evicted, &values](std::string_view key, const kvstore::ValuePtr& value, kvstore::EvictionReason reason) {
+        evicted.emplace_back(std::string(key), reason);
+        values.push_back(*value);
+    };
+    kvstore::KVStore evicting(options);
+    
+    evicting.put("a", "v_a");
+    evicting.put("b", "v_b");
+    evicting.put("c", "v_c");  // Full: a goes
+    evicting.remove("b");
+    evicting.put("d", std::string(40 * 1024, 'd'));
+    evicting.put("e", std::string(40 * 1024, 'e'));  // Over budget: c or d goes
+    evicting.put("t", "v_t", std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::string value;
+    EXPECT_FALSE(evicting.get("t", value));
+    
+    using Reason = kvstore::EvictionReason;
+    ASSERT_GE(evicted.size(), 4u);
+    EXPECT_EQ(evicted[0], std::make_pair(std::string("a"), Reason::Capacity));
+    EXPECT_EQ(values[0], "v_a");
+    EXPECT_EQ(evicted[1], std::make_pair(std::string("b"), Reason::Explicit));
+    EXPECT_EQ(evicted.back(), std::make_pair(std::string("t"), Reason::Expired));
+    
+    const auto& metrics = evicting.get_metrics();
+    EXPECT_EQ(metrics.evictions_by_reason[static_cast<size_t>(Reason::Explicit)].load(), 1u);
+    EXPECT_EQ(metrics.evictions_by_reason[static_cast<size_t>(Reason::Expired)].load(), 1u);
+    EXPECT_GE(metrics.evictions_by_reason[static_cast<size_t>(Reason::Memory)].load(), 1u);
+    EXPECT_EQ(metrics.evictions.load(), evicted.size() - 2);
+    
+    evicting.reset_metrics();
+    EXPECT_EQ(evicting.get_metrics().evictions.load(), 0u);
+}
+
+TEST_F(KVStoreTest, SampledOperationLatency) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 100;
+    options.latency_sample_every = 1;
+    kvstore::KVStore timed(options);
+    
+    std::string value;
+    for (int i = 0; i < 10; ++i) {
+        timed.put("key" + std::to_string(i), "value");
+        timed.get("key" + std::to_string(i), value);
+    }
+    timed.remove("key0");
+    timed.multi_get({"key1", "key2"});
+    
+    const auto& metrics = timed.get_metrics();
+    EXPECT_EQ(metrics.latency[static_cast<size_t>(kvstore::OpType::Get)].count(), 10u);
+    EXPECT_EQ(metrics.latency[static_cast<size_t>(kvstore::OpType::Put)].count(), 10u);
+    EXPECT_EQ(metrics.latency[static_cast<size_t>(kvstore::OpType::Del)].count(), 1u);
+    EXPECT_GT(metrics.latency[static_cast<size_t>(kvstore::OpType::Get)].percentile(99), 0u);
+    
+    options.latency_sample_every = 0;
+    kvstore::KVStore untimed(options);
+    untimed.put("key", "value");
+    EXPECT_EQ(untimed.get_metrics().latency[static_cast<size_t>(kvstore::OpType::Put)].count(), 0u);
+}
+
+TEST_F(KVStoreTest, LockStatsRecordWaitAndHold) {
+    kvstore::KVStoreOptions options;
+    options.capacity = 1000;
+    options.num_shards = 2;
+    options.lock_stats = true;
+    kvstore::KVStore instrumented(options);
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&instrumented, t] {
+            std::string value;
+            for (int i = 0; i < 2000; ++i) {
+                std::string key = "key" + std::to_string((t * 2000 + i) % 500);
+                instrumented.put(key, "value");
+                instrumented.get(key, value);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    const auto& metrics = instrumented.get_metrics();
+    ASSERT_EQ(metrics.shard_locks.size(), 2u);
+    uint64_t exclusive = 0;
+    for (const auto& lock : metrics.shard_locks) {
+        exclusive += lock.exclusive.acquisitions;
+        EXPECT_GT(lock.exclusive.hold_ns.load(), 0u);
+        EXPECT_LE(lock.exclusive.contended.load(), lock.exclusive.acquisitions.load());
+        EXPECT_EQ(lock.exclusive.contended.load() == 0, lock.exclusive.wait_ns.load() == 0);
+    }
+    // Every put and, under strict recency, every get hit takes the exclusive lock
+    EXPECT_GE(exclusive, 8000u);
+    
+    // Uninstrumented stores report nothing
+    EXPECT_TRUE(store->get_metrics().shard_locks.empty());
+}
+
+TEST(InstrumentedSharedMutexTest, OutOfOrderSharedUnlocks) {
+    kvstore::InstrumentedSharedMutex outer(true);
+    kvstore::InstrumentedSharedMutex inner(true);
+    
+    // Release outer first; each lock is still charged only its own hold
+    outer.lock_shared();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    inner.lock_shared();
+    outer.unlock_shared();
+    inner.unlock_shared();
+    
+    EXPECT_GE(outer.stats().shared.hold_ns.load(), 20000000u);
+    EXPECT_LT(inner.stats().shared.hold_ns.load(), outer.stats().shared.hold_ns.load());
+}
+
+TEST(LRUCacheTest, ExpiresWithoutWrites) {
+    kvstore::CacheOptions options;
+    options.capacity = 0;
+    options.max_memory_bytes = 64 * 1024;
+    options.recency = kvstore::RecencyMode::Clock;
+    options.lock_stats = true;
+    kvstore::LRUCache cache(options);
+    cache.put("keep", "value");
+    for (int i = 0; i < 10; ++i) {
+        cache.put("ttl_" + std::to_string(i), std::string(1000, 'v'), std::chrono::milliseconds(20));
+    }
+    size_t charged = cache.memory_usage();
+    
+    // Only shared-lock reads from here on; the clock thread reclaims the rest
+    std::string value;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (cache.size() != 1 && std::chrono::steady_clock::now() < deadline) {
+        cache.get("keep", value);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_LT(cache.memory_usage(), charged / 5);
+    
+    // With no timers left the clock thread stops taking the exclusive lock
+    uint64_t exclusive = cache.lock_stats().exclusive.acquisitions.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(cache.lock_stats().exclusive.acquisitions.load(), exclusive);
+}
+
+TEST(LRUCacheTest, AccessCountSaturates) {
+    kvstore::LRUCache cache(10);
+    cache.put("key", "value");
+    std::string value;
+    for (int i = 0; i < 300; ++i) {
+        cache.get("key", value);
+    }
+    kvstore::EntryInfo info;
+    ASSERT_TRUE(cache.inspect("key", info));
+    EXPECT_EQ(info.access_count, 255u);
+    EXPECT_EQ(sizeof(kvstore::CacheEntry::meta), sizeof(uint32_t));
+}
+
+TEST(SlabAllocatorTest, ReusesFreedSlots) {
+    kvstore::SlabAllocator slab;
+    char* a = slab.allocate(20);
+    char* b = slab.allocate(24);
+    EXPECT_EQ(b, a + 24);
+    EXPECT_EQ(slab.requested_bytes(), 44u);
+    EXPECT_EQ(slab.reserved_bytes(), kvstore::SlabAllocator::kPageSize);
+    
+    // A freed slot goes to the next allocation in the same size class only
+    slab.deallocate(a, 20);
+    char* c = slab.allocate(100);
+    EXPECT_NE(c, a);
+    EXPECT_EQ(slab.allocate(17), a);
+    
+    // Oversized requests bypass the pages
+    char* big = slab.allocate(kvstore::SlabAllocator::kMaxSlabSize + 1);
+    EXPECT_EQ(slab.reserved_bytes(), 2 * kvstore::SlabAllocator::kPageSize + kvstore::SlabAllocator::kMaxSlabSize + 1);
+    slab.deallocate(big, kvstore::SlabAllocator::kMaxSlabSize + 1);
+    EXPECT_EQ(slab.allocate(0), nullptr);
+    
+    slab.clear();
+    EXPECT_EQ(slab.requested_bytes(), 0u);
+    EXPECT_EQ(slab.reserved_bytes(), 0u);
+}
+
+TEST(StripedCounterTest, SumsConcurrentAdds) {
+    kvstore::StripedCounter counter;
+    const int num_threads = 8;
+    const int adds_per_thread = 10000;
+    
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&counter] {
+            for (int i = 0; i < adds_per_thread; ++i) {
+                counter++;
+            }
+            counter += 5;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    EXPECT_EQ(counter.load(), static_cast<uint64_t>(num_threads) * (adds_per_thread + 5));
+    counter.reset();
+    EXPECT_EQ(counter.load(), 0u);
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinBucketError) {
+    kvstore::LatencyHistogram histogram;
+    for (uint64_t ns = 1; ns <= 100000; ++ns) {
+        histogram.record(ns * 10);
+    }
+    std::thread other([&histogram] { histogram.record(kvstore::LatencyHistogram::kMaxValue + 1); });
+    other.join();
+    
+    auto snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.total, 100001u);
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        double exact = p / 100.0 * 100001 * 10;
+        EXPECT_NEAR(static_cast<double>(snapshot.percentile(p)), exact, exact / kvstore::LatencyHistogram::kSubBuckets);
+    }
+    EXPECT_EQ(snapshot.percentile(100), kvstore::LatencyHistogram::kMaxValue);
+    EXPECT_EQ(snapshot.percentile(0), 10u);
+    
+    // Bucket bounds line up with the index mapping
+    for (uint64_t v : {0ull, 63ull, 64ull, 65ull, 1000ull, 123456789ull}) {
+        size_t i = kvstore::LatencyHistogram::bucket_index(v);
+        EXPECT_LE(kvstore::LatencyHistogram::bucket_floor(i), v);
+        EXPECT_GT(kvstore::LatencyHistogram::bucket_floor(i + 1), v);
+    }
+    
+    histogram.reset();
+    EXPECT_EQ(histogram.count(), 0u);
+}
+
+TEST(FlatIndexTest, InsertFindErase) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 5000; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+    }
+    auto find = [&keys](const kvstore::FlatIndex& index, const std::string& key) {
+        return index.find(kvstore::hash_key(key), [&](uint32_t id) { return keys[id] == key; });
+    };
+    
+    kvstore::FlatIndex index;
+    for (uint32_t id = 0; id < keys.size(); ++id) {
+        index.insert(kvstore::hash_key(keys[id]), id);
+    }
+    EXPECT_EQ(index.size(), keys.size());
+    EXPECT_GE(index.capacity(), keys.size());
+    
+    for (uint32_t id = 0; id < keys.size(); ++id) {
+        ASSERT_EQ(find(index, keys[id]), id);
+    }
+    EXPECT_EQ(find(index, "missing"), kvstore::FlatIndex::kNotFound);
+    
+    // Erase every other key; survivors must stay reachable past tombstones
+    for (uint32_t id = 0; id < keys.size(); id += 2) {
+        ASSERT_TRUE(index.erase(kvstore::hash_key(keys[id]), id));
+    }
+    EXPECT_FALSE(index.erase(kvstore::hash_key(keys[0]), 0));
+    EXPECT_EQ(index.size(), keys.size() / 2);
+    for (uint32_t id = 0; id < keys.size(); ++id) {
+        uint32_t expected = (id % 2 == 0) ? kvstore::FlatIndex::kNotFound : id;
+        ASSERT_EQ(find(index, keys[id]), expected);
+    }
+    
+    index.clear();
+    EXPECT_EQ(index.size(), 0);
+    EXPECT_EQ(find(index, keys[1]), kvstore::FlatIndex::kNotFound);
+}
+
+TEST(FlatIndexTest, IncrementalResize) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 20000; ++i) {
+        keys.push_back("key_" + std::to_string(i));
+    }
+    auto find = [&keys](const kvstore::FlatIndex& index, uint32_t id) {
+        const std::string& key = keys[id];
+        return index.find(kvstore::hash_key(key), [&](uint32_t other) { return keys[other] == key; });
+    };
+    
+    // Every key stays reachable while groups move between tables, and a
+    // scan started mid-resize still returns all of them
+    kvstore::FlatIndex index;
+    bool checked_scan = false;
+    for (uint32_t id = 0; id < keys.size(); ++id) {
+        index.insert(kvstore::hash_key(keys[id]), id);
+        ASSERT_EQ(find(index, id), id);
+        ASSERT_EQ(find(index, id / 2), id / 2);
+        if (index.resizing() && id > 5000 && !checked_scan) {
+            std::set<uint32_t> seen;
+            uint64_t cursor = 0;
+            do {
+                cursor = index.scan(cursor, [&](uint32_t found) { seen.insert(found); });
+            } while (cursor != 0);
+            EXPECT_EQ(seen.size(), id + 1);
+            checked_scan = true;
+        }
+    }
+    EXPECT_TRUE(checked_scan);
+    EXPECT_EQ(index.size(), keys.size());
+    
+    for (uint32_t id = 0; id < keys.size(); id += 2) {
+        ASSERT_TRUE(index.erase(kvstore::hash_key(keys[id]), id));
+    }
+    for (uint32_t id = 0; id < keys.size(); ++id) {
+        ASSERT_EQ(find(index, id), id % 2 == 0 ? kvstore::FlatIndex::kNotFound : id);
+    }
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();